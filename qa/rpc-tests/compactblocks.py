@@ -0,0 +1,140 @@
+#!/usr/bin/env python2
+# Copyright (c) 2016 The Bitcoin Core developers
+# Copyright (c) 2015-2018 The Luxcore developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#
+# Exercise compact block relay. Node 0 mines; nodes 1-3 are each connected
+# only to node 0 and receive its blocks as:
+#   node 1: compact blocks pushed in high-bandwidth mode (-compacthbpeer)
+#   node 2: compact blocks fetched after an inv (low-bandwidth mode)
+#   node 3: full blocks (-compactblocks=0)
+# For every block the bytes and round trips each node needed are compared,
+# using the per-message byte counters of getpeerinfo. The last block is
+# staked by node 0, so its coinstake has to be prefilled as well.
+#
+
+from test_framework import BitcoinTestFramework
+from util import *
+import time
+
+BLOCK_MESSAGES = ["inv", "getdata", "block", "cmpctblock", "getblocktxn", "blocktxn"]
+
+class CompactBlocksTest(BitcoinTestFramework):
+
+    def setup_network(self):
+        # Only node 0 stakes, once the mock time has aged its coins
+        args = [["-debug=net", "-debug=cmpctblock"],
+                ["-debug=net", "-debug=cmpctblock", "-compacthbpeer=127.0.0.1", "-staking=0"],
+                ["-debug=net", "-debug=cmpctblock", "-staking=0"],
+                ["-debug=net", "-compactblocks=0", "-staking=0"]]
+        self.nodes = start_nodes(4, self.options.tmpdir, args)
+        for i in range(1, 4):
+            connect_nodes(self.nodes[i], 0)
+        self.is_network_split = False
+        self.sync_all()
+
+    def message_bytes(self, node):
+        # Nodes 1-3 only have node 0 as a peer
+        peers = node.getpeerinfo()
+        assert_equal(len(peers), 1)
+        sent = peers[0]["bytessent_per_msg"]
+        recv = peers[0]["bytesrecv_per_msg"]
+        return (dict((m, sent.get(m, 0)) for m in BLOCK_MESSAGES),
+                dict((m, recv.get(m, 0)) for m in BLOCK_MESSAGES))
+
+    def mine_block(self):
+        self.nodes[0].setgenerate(True, 1)
+
+    def stake_block(self):
+        tip = self.nodes[0].getbestblockhash()
+        self.nodes[0].reservebalance(False)
+        for i in range(120):
+            best = self.nodes[0].getbestblockhash()
+            if best != tip:
+                assert(self.nodes[0].getblock(best)["flags"].startswith("proof-of-stake"))
+                return
+            time.sleep(1)
+        raise AssertionError("node 0 did not stake a block")
+
+    def relay_block(self, ntx, produce=None):
+        for i in range(ntx):
+            self.nodes[0].sendtoaddress(self.nodes[1 + i % 3].getnewaddress(), 1)
+        sync_mempools(self.nodes)
+
+        before = [self.message_bytes(self.nodes[i]) for i in range(1, 4)]
+        (produce or self.mine_block)()
+        sync_blocks(self.nodes)
+        after = [self.message_bytes(self.nodes[i]) for i in range(1, 4)]
+
+        stats = []
+        for i in range(3):
+            sent = dict((m, after[i][0][m] - before[i][0][m]) for m in BLOCK_MESSAGES)
+            recv = dict((m, after[i][1][m] - before[i][1][m]) for m in BLOCK_MESSAGES)
+            # An unsolicited cmpctblock is half a round trip, inv/getdata/reply
+            # one and a half, and each getblocktxn/blocktxn exchange one more
+            round_trips = 0.5
+            if sent["getdata"] > 0:
+                round_trips += 1
+            if sent["getblocktxn"] > 0:
+                round_trips += 1
+            stats.append((sum(recv.values()) + sum(sent.values()), round_trips, sent, recv))
+            print "%2d txn, node %d: %6d bytes, %.1f round trips" % (ntx, i + 1, stats[-1][0], round_trips)
+        return stats
+
+    def run_test(self):
+        for i in range(1, 3):
+            peer = self.nodes[i].getpeerinfo()[0]
+            assert_equal(peer["cmpctblocks"], True)
+            assert_equal(peer["cmpct_hb_from"], i == 1)
+        assert_equal(self.nodes[3].getpeerinfo()[0]["cmpctblocks"], False)
+
+        for ntx in [0, 5, 25]:
+            self.check_relay(ntx, *self.relay_block(ntx))
+
+        # Age node 0's coins past the stake minimum age, then let it stake a
+        # block. A fresh PoW block first keeps the nodes out of initial block
+        # download at the new time. Reserving the whole balance holds the
+        # staker back until the transactions are in the mempools.
+        self.nodes[0].reservebalance(True, self.nodes[0].getbalance() + 1)
+        set_node_times(self.nodes, int(time.time()) + 40 * 60 * 60)
+        self.mine_block()
+        sync_blocks(self.nodes)
+        hb, lb, full = self.relay_block(5, self.stake_block)
+        self.check_relay(5, hb, lb, full)
+        # The coinbase and the coinstake are prefilled, the other transactions
+        # were in the mempools, so nothing is left to fetch...
+        assert_equal(hb[2]["getblocktxn"], 0)
+        assert_equal(lb[2]["getblocktxn"], 0)
+        # and every node rebuilt and connected the staked block
+        best = self.nodes[0].getbestblockhash()
+        for node in self.nodes[1:]:
+            assert(node.getblock(best)["flags"].startswith("proof-of-stake"))
+
+        assert_equal(len(set(node.getbestblockhash() for node in self.nodes)), 1)
+
+    def check_relay(self, ntx, hb, lb, full):
+        # High-bandwidth: pushed as a compact block without an inv
+        assert_equal(hb[1], 0.5)
+        assert_equal(hb[3]["block"], 0)
+        assert(hb[3]["cmpctblock"] > 0)
+
+        # Low-bandwidth: the inv is answered with a compact block
+        assert_equal(lb[1], 1.5)
+        assert_equal(lb[3]["block"], 0)
+        assert(lb[3]["cmpctblock"] > 0)
+
+        # Full blocks for the peer that opted out
+        assert_equal(full[1], 1.5)
+        assert(full[3]["block"] > 0)
+        assert_equal(full[3]["cmpctblock"], 0)
+
+        # Every transaction was already in the mempools, so compact blocks
+        # are smaller than the full block as soon as there are any
+        if ntx > 0:
+            assert_greater_than(full[3]["block"], hb[3]["cmpctblock"])
+            assert_greater_than(full[0], lb[0])
+
+if __name__ == '__main__':
+    CompactBlocksTest().main()
@@ -0,0 +1,128 @@
+#!/usr/bin/env python2
+# Copyright (c) 2015-2018 The Luxcore developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#
+# Stress the socket handler with more inbound connections than select() can
+# watch. For every -socketevents backend without the FD_SETSIZE limit a node
+# is started, 1000 raw loopback connections send it a version message, and
+# every one of them has to get version and verack back.
+#
+
+from test_framework import BitcoinTestFramework
+from util import *
+
+import hashlib
+import resource
+import select
+import socket
+import struct
+import time
+
+NUM_CONNECTIONS = 1000
+REGTEST_MAGIC = "\xa1\xcf\x7e\xac"
+
+def sha256d(data):
+    return hashlib.sha256(hashlib.sha256(data).digest()).digest()
+
+def ser_string(s):
+    assert(len(s) < 253)
+    return struct.pack("<B", len(s)) + s
+
+def ser_address(port):
+    # services, IPv4-mapped 127.0.0.1, port
+    return struct.pack("<Q", 1) + "\x00" * 10 + "\xff\xff" + socket.inet_aton("127.0.0.1") + struct.pack(">H", port)
+
+def message(command, payload):
+    return (REGTEST_MAGIC + struct.pack("<12s", command) + struct.pack("<I", len(payload)) +
+            sha256d(payload)[:4] + payload)
+
+def version_message(nVersion, strSubVer, port, nonce):
+    payload = struct.pack("<iQq", nVersion, 1, int(time.time()))
+    payload += ser_address(port) + ser_address(0)
+    payload += struct.pack("<Q", nonce) + ser_string(strSubVer) + struct.pack("<i", 0)
+    return message("version", payload)
+
+def read_commands(data):
+    """ Split the complete messages off a receive buffer """
+    commands = []
+    while len(data) >= 24:
+        assert_equal(data[:4], REGTEST_MAGIC)
+        length = struct.unpack("<I", data[16:20])[0]
+        if len(data) < 24 + length:
+            break
+        commands.append(data[4:16].rstrip("\x00"))
+        data = data[24 + length:]
+    return commands, data
+
+class SocketEventsStressTest(BitcoinTestFramework):
+
+    def setup_chain(self):
+        print("Initializing test directory "+self.options.tmpdir)
+        initialize_chain_clean(self.options.tmpdir, 1)
+
+    def setup_network(self):
+        self.nodes = []
+        self.is_network_split = False
+
+    def stress(self, mode):
+        print "Opening %d connections with -socketevents=%s" % (NUM_CONNECTIONS, mode)
+        self.nodes = [start_node(0, self.options.tmpdir, ["-socketevents=" + mode, "-maxconnections=%d" % (NUM_CONNECTIONS + 100)])]
+        node = self.nodes[0]
+        info = node.getnetworkinfo()
+
+        socks = []
+        for i in range(NUM_CONNECTIONS):
+            s = socket.create_connection(("127.0.0.1", p2p_port(0)))
+            s.sendall(version_message(info["protocolversion"], str(info["subversion"]), p2p_port(0), i + 1))
+            socks.append(s)
+
+        # Wait for version and verack on every connection
+        poller = select.poll()
+        by_fd = {}
+        for s in socks:
+            poller.register(s.fileno(), select.POLLIN)
+            by_fd[s.fileno()] = [s, "", set()]
+        pending = len(socks)
+        deadline = time.time() + 120
+        while pending > 0:
+            assert(time.time() < deadline)
+            for fd, event in poller.poll(1000):
+                entry = by_fd[fd]
+                data = entry[0].recv(65536)
+                assert(len(data) > 0)
+                commands, entry[1] = read_commands(entry[1] + data)
+                entry[2].update(commands)
+                if "version" in entry[2] and "verack" in entry[2]:
+                    poller.unregister(fd)
+                    pending -= 1
+
+        assert_greater_than(node.getconnectioncount(), NUM_CONNECTIONS - 1)
+
+        for s in socks:
+            s.close()
+        deadline = time.time() + 60
+        while node.getconnectioncount() > 0:
+            assert(time.time() < deadline)
+            time.sleep(0.5)
+
+        # The handler kept up, RPC is still served
+        assert_equal(node.getblockcount(), 0)
+        stop_nodes(self.nodes)
+        wait_bitcoinds()
+
+    def run_test(self):
+        soft, hard = resource.getrlimit(resource.RLIMIT_NOFILE)
+        needed = NUM_CONNECTIONS + 200
+        if hard != resource.RLIM_INFINITY and hard < needed:
+            print "Skipping, file descriptor limit %d is below %d" % (hard, needed)
+            return
+        if soft != resource.RLIM_INFINITY and soft < needed:
+            resource.setrlimit(resource.RLIMIT_NOFILE, (needed, hard))
+
+        for mode in ["epoll", "poll"]:
+            self.stress(mode)
+
+if __name__ == '__main__':
+    SocketEventsStressTest().main()
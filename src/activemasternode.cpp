@@ -187,11 +187,14 @@ bool CActiveMasternode::Dseep(CTxIn vin, CService service, CKey keyMasternode, C
 
     // Update Last Seen timestamp in masternode list
     bool found = false;
-    for (CMasterNode& mn : vecMasternodes) {
-        //LogPrintf(" -- %s\n", mn.vin.ToString().c_str());
-        if (mn.vin == vin) {
-            found = true;
-            mn.UpdateLastSeen();
+    {
+        LOCK(cs_masternodes);
+        for (CMasterNode& mn : vecMasternodes) {
+            //LogPrintf(" -- %s\n", mn.vin.ToString().c_str());
+            if (mn.vin == vin) {
+                found = true;
+                mn.UpdateLastSeen();
+            }
         }
     }
 
@@ -80,6 +80,7 @@ struct CMempoolAddressDeltaKeyCompare
 typedef std::vector<std::pair<uint160, uint16_t> > AddressTypeVector;
 typedef std::vector<std::pair<CAddressIndexKey, CAmount> > AddressIndexVector;
 typedef std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > AddressUnspentVector;
+typedef std::map<CAddressIndexIteratorKey, CAddressSummaryValue, CAddressIndexIteratorKeyCompare> AddressSummaryMap;
 
 typedef std::vector<std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> > MempoolAddrDeltaVector;
 
@@ -182,6 +182,9 @@ public:
     int64_t nMint;
     int64_t nMoneySupply;
 
+    //! (memory only) block that created the stake input of this proof-of-stake block, NULL if not known yet
+    const CBlockIndex* pindexStakeOrigin;
+
     //! block header
     int nVersion;
     uint256 hashMerkleRoot;
@@ -221,6 +224,7 @@ public:
         nStakeModifierChecksum = 0;
         prevoutStake.SetNull();
         nStakeTime = 0;
+        pindexStakeOrigin = NULL;
 
         nVersion = 0;
         hashMerkleRoot = 0;
@@ -280,6 +280,17 @@ void CCoinsViewCache::Uncache(const uint256& hash)
     }
 }
 
+void CCoinsViewCache::AddPrefetched(const uint256& txid, CCoins& coins)
+{
+    if (coins.IsPruned())
+        return;
+    std::pair<CCoinsMap::iterator, bool> ret = cacheCoins.insert(std::make_pair(txid, CCoinsCacheEntry()));
+    if (!ret.second)
+        return;
+    coins.swap(ret.first->second.coins);
+    cachedCoinsUsage += ret.first->second.coins.DynamicMemoryUsage();
+}
+
 unsigned int CCoinsViewCache::GetCacheSize() const
 {
     return cacheCoins.size();
@@ -64,22 +64,28 @@ public:
         return fCoinStake;
     }
 
+    unsigned int GetSerializeSize(int nType, int nVersion) const {
+        uint32_t code = (nHeight << 2) + (fCoinBase ? 1 : 0) + (fCoinStake ? 2 : 0);
+        return ::GetSerializeSize(VARINT(code), nType, nVersion) +
+               ::GetSerializeSize(CTxOutCompressor(REF(out)), nType, nVersion);
+    }
+
     template<typename Stream>
-    void Serialize(Stream &s) const {
+    void Serialize(Stream &s, int nType, int nVersion) const {
         assert(!IsSpent());
         uint32_t code = (nHeight << 2) + (fCoinBase ? 1 : 0) + (fCoinStake ? 2 : 0);
-        ::Serialize(s, VARINT(code));
-        ::Serialize(s, CTxOutCompressor(REF(out)));
+        ::Serialize(s, VARINT(code), nType, nVersion);
+        ::Serialize(s, CTxOutCompressor(REF(out)), nType, nVersion);
     }
 
     template<typename Stream>
-    void Unserialize(Stream &s) {
+    void Unserialize(Stream &s, int nType, int nVersion) {
         uint32_t code = 0;
-        ::Unserialize(s, VARINT(code));
+        ::Unserialize(s, VARINT(code), nType, nVersion);
         nHeight = code >> 2;
         fCoinBase = code & 1;
         fCoinStake = (code >> 1) & 1;
-        ::Unserialize(s, REF(CTxOutCompressor(out)));
+        ::Unserialize(s, REF(CTxOutCompressor(out)), nType, nVersion);
     }
 
     bool IsSpent() const {
@@ -545,6 +551,15 @@ public:
 
     void Uncache(const uint256 &txid);
 
+    /**
+     * Insert coins read from the base view on other threads, unless this cache already
+     * has an entry for txid. The base view must not have changed since they were read.
+     */
+    void AddPrefetched(const uint256 &txid, CCoins &coins);
+
+    //! The view this cache reads from, for reads made on other threads (the base must allow that)
+    const CCoinsView* GetBase() const { return base; }
+
     //! Calculate the size of the cache (in number of transactions)
     unsigned int GetCacheSize() const;
 
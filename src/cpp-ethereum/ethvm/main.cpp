@@ -43,7 +43,7 @@ static const int64_t MaxBlockGasLimit = ChainParams(genesisInfo(Network::MainNet
 void help()
 {
 	cout
-		<< "Usage ethvm <options> [trace|stats|output|test] (<file>|-)" << endl
+		<< "Usage ethvm <options> [trace|stats|output|test|bench] (<file>|-)" << endl
 		<< "Transaction options:" << endl
 		<< "    --value <n>  Transaction should transfer the <n> wei (default: 0)." << endl
 		<< "    --gas <n>    Transaction should be given <n> gas (default: block gas limit)." << endl
@@ -65,6 +65,9 @@ void help()
 		<< "    --flat  Minimal whitespace in the JSON." << endl
 		<< "    --mnemonics  Show instruction mnemonics in the trace (non-standard)." << endl
 		<< endl
+		<< "Options for bench:" << endl
+		<< "    --repeat <n>  Run the code <n> times (default: 100)." << endl
+		<< endl
 		<< "General options:" << endl
 		<< "    -V,--version  Show the version and exit." << endl
 		<< "    -h,--help  Show this help message and exit." << endl;
@@ -111,7 +114,12 @@ enum class Mode
 	/// Test mode -- output information needed for test verification and
 	/// benchmarking. The execution is not introspected not to degrade
 	/// performance.
-	Test
+	Test,
+
+	/// Benchmark mode -- run the code repeatedly and report instructions per
+	/// second for the interpreter's dispatch configuration. Build once with
+	/// EVM_JUMP_DISPATCH=true to compare against the jump table dispatch.
+	Benchmark
 };
 
 int main(int argc, char** argv)
@@ -133,6 +141,7 @@ int main(int argc, char** argv)
 	envInfo.setGasLimit(MaxBlockGasLimit);
 	bytes data;
 	bytes code;
+	unsigned repeat = 100;
 
 	Ethash::init();
 	NoProof::init();
@@ -210,6 +219,10 @@ int main(int argc, char** argv)
 			mode = Mode::Trace;
 		else if (arg == "test")
 			mode = Mode::Test;
+		else if (arg == "bench")
+			mode = Mode::Benchmark;
+		else if (arg == "--repeat" && i + 1 < argc)
+			repeat = max(1, atoi(argv[++i]));
 		else if (arg == "--input" && i + 1 < argc)
 			data = fromHex(argv[++i]);
 		else if (arg == "--code" && i + 1 < argc)
@@ -268,10 +281,48 @@ int main(int argc, char** argv)
 	state.addBalance(sender, value);
 
 	unique_ptr<SealEngineFace> se(ChainParams(genesisInfo(networkName)).createSealEngine());
+	t.forceSender(sender);
+
+	if (mode == Mode::Benchmark)
+	{
+		// Every run starts from the same state; the first one also counts the
+		// executed instructions, the timed ones are not introspected.
+		uint64_t steps = 0;
+		double benchTime = 0;
+		ExecutionResult benchRes;
+		for (unsigned run = 0; run <= repeat; ++run)
+		{
+			State runState = state;
+			Executive runExecutive(runState, envInfo, *se);
+			runExecutive.setResultRecipient(benchRes);
+			runExecutive.initialize(t);
+			if (!code.empty())
+				runExecutive.call(contractDestination, sender, value, gasPrice, &data, gas);
+			else
+				runExecutive.create(sender, value, gasPrice, gas, &data, origin);
+
+			Timer timer;
+			if (run == 0)
+				runExecutive.go([&](uint64_t step, uint64_t, Instruction, bigint, bigint, bigint, VM*, ExtVMFace const*) { steps = step; });
+			else
+				runExecutive.go();
+			if (run > 0)
+				benchTime += timer.elapsed();
+			runExecutive.finalize();
+		}
+
+		cout << "dispatch: " << VM::configuration() << '\n';
+		cout << "exception: " << boolalpha << (benchRes.excepted != TransactionException::None) << '\n';
+		cout << "gas used: " << benchRes.gasUsed << '\n';
+		cout << "instructions: " << steps << " x " << repeat << '\n';
+		cout << "exec time: " << fixed << setprecision(6) << benchTime << '\n';
+		cout << "instructions/sec: " << scientific << setprecision(3) << double(steps) * repeat / benchTime << '\n';
+		return 0;
+	}
+
 	Executive executive(state, envInfo, *se);
 	ExecutionResult res;
 	executive.setResultRecipient(res);
-	t.forceSender(sender);
 
 	unordered_map<byte, pair<unsigned, bigint>> counts;
 	unsigned total = 0;
@@ -44,62 +44,240 @@ class WriteBatchNoter: public ldb::WriteBatch::Handler
 	virtual void Delete(ldb::Slice const& _key) { cnote << "Delete" << toHex(bytesConstRef(_key)); }
 };
 
+namespace
+{
+/// Reference count of a node, next to it like the aux entries (which use 255).
+bytes refKey(h256 const& _h)
+{
+	bytes b = _h.asBytes();
+	b.push_back(254);
+	return b;
+}
+
+/// Journal of block _era, shorter than any node key so it can't collide with one.
+bytes journalKey(unsigned _era)
+{
+	return bytes{'j', 'r', 'n', 'l', byte(_era >> 24), byte(_era >> 16), byte(_era >> 8), byte(_era)};
+}
+}
+
 void OverlayDB::commit()
+{
+	stage();
+	flush();
+}
+
+void OverlayDB::stage()
 {
 	if (m_db)
 	{
-		ldb::WriteBatch batch;
-//		cnote << "Committing nodes to disk DB:";
 #if DEV_GUARDED_DB
-		DEV_READ_GUARDED(x_this)
+		DEV_WRITE_GUARDED(x_this)
 #endif
 		{
+			WriteGuard l(m_staged->x_staged);
 			for (auto const& i: m_main)
 			{
-				if (i.second.second)
-					batch.Put(ldb::Slice((char const*)i.first.data(), i.first.size), ldb::Slice(i.second.first.data(), i.second.first.size()));
-//				cnote << i.first << "#" << m_main[i.first].second;
+				if (i.second.second && m_staged->main.emplace(i.first, i.second.first).second)
+					m_staged->size += i.second.first.size();
+				if (i.second.second && m_staged->pruning)
+					m_staged->inserts[i.first] += i.second.second;
 			}
 			for (auto const& i: m_aux)
 				if (i.second.second)
 				{
-					bytes b = i.first.asBytes();
-					b.push_back(255);	// for aux
-					batch.Put(bytesConstRef(&b), bytesConstRef(&i.second.first));
+					if (!m_staged->aux.count(i.first))
+						m_staged->size += i.second.first.size();
+					m_staged->aux[i.first] = i.second.first;
 				}
+			m_aux.clear();
+			m_main.clear();
 		}
+	}
+}
 
-		for (unsigned i = 0; i < 10; ++i)
+void OverlayDB::writeStaged(ldb::WriteBatch& _batch)
+{
+//	cnote << "Committing nodes to disk DB:";
+	for (auto const& i: m_staged->main)
+		_batch.Put(ldb::Slice((char const*)i.first.data(), i.first.size), ldb::Slice(i.second.data(), i.second.size()));
+	for (auto const& i: m_staged->aux)
+	{
+		bytes b = i.first.asBytes();
+		b.push_back(255);	// for aux
+		_batch.Put(bytesConstRef(&b), bytesConstRef(&i.second));
+	}
+}
+
+void OverlayDB::write(ldb::WriteBatch& _batch)
+{
+	for (unsigned i = 0; i < 10; ++i)
+	{
+		ldb::Status o = m_db->Write(m_writeOptions, &_batch);
+		if (o.ok())
+			break;
+		if (i == 9)
 		{
-			ldb::Status o = m_db->Write(m_writeOptions, &batch);
-			if (o.ok())
-				break;
-			if (i == 9)
-			{
-				cwarn << "Fail writing to state database. Bombing out.";
-				exit(-1);
-			}
-			cwarn << "Error writing to state database: " << o.ToString();
-			WriteBatchNoter n;
-			batch.Iterate(&n);
-			cwarn << "Sleeping for" << (i + 1) << "seconds, then retrying.";
-			this_thread::sleep_for(chrono::seconds(i + 1));
+			cwarn << "Fail writing to state database. Bombing out.";
+			exit(-1);
 		}
-#if DEV_GUARDED_DB
-		DEV_WRITE_GUARDED(x_this)
-#endif
+		cwarn << "Error writing to state database: " << o.ToString();
+		WriteBatchNoter n;
+		_batch.Iterate(&n);
+		cwarn << "Sleeping for" << (i + 1) << "seconds, then retrying.";
+		this_thread::sleep_for(chrono::seconds(i + 1));
+	}
+}
+
+void OverlayDB::clearStaged()
+{
+	// Everything staged is on disk already, readers that miss it here find it there
+	WriteGuard l(m_staged->x_staged);
+	m_staged->main.clear();
+	m_staged->aux.clear();
+	m_staged->size = 0;
+	m_staged->inserts.clear();
+	m_staged->kills.clear();
+}
+
+unsigned& OverlayDB::refs(std::unordered_map<h256, unsigned>& _refs, h256 const& _h) const
+{
+	auto it = _refs.find(_h);
+	if (it == _refs.end())
+	{
+		std::string v;
+		bytes k = refKey(_h);
+		m_db->Get(m_readOptions, bytesConstRef(&k), &v);
+		it = _refs.emplace(_h, v.empty() ? 0 : RLP(v).toInt<unsigned>()).first;
+	}
+	return it->second;
+}
+
+void OverlayDB::release(ldb::WriteBatch& _batch, std::unordered_map<h256, unsigned>& _refs, h256s const& _hs) const
+{
+	for (auto const& h: _hs)
+	{
+		unsigned& r = refs(_refs, h);
+		// Nodes without a count (the empty trie, anything written before pruning) are never deleted.
+		if (!r)
+			continue;
+		if (!--r && !m_staged->main.count(h))
+			_batch.Delete(ldb::Slice((char const*)h.data(), h.size));
+	}
+}
+
+void OverlayDB::writeRefs(ldb::WriteBatch& _batch, std::unordered_map<h256, unsigned> const& _refs) const
+{
+	for (auto const& i: _refs)
+	{
+		bytes k = refKey(i.first);
+		if (i.second)
 		{
-			m_aux.clear();
-			m_main.clear();
+			bytes v = rlp(i.second);
+			_batch.Put(bytesConstRef(&k), bytesConstRef(&v));
 		}
+		else
+			_batch.Delete(bytesConstRef(&k));
 	}
 }
 
+void OverlayDB::flush()
+{
+	if (m_db && (!m_staged->main.empty() || !m_staged->aux.empty()))
+	{
+		ldb::WriteBatch batch;
+		writeStaged(batch);
+		if (m_staged->pruning)
+		{
+			// Not part of a block, the references are counted but never journaled.
+			std::unordered_map<h256, unsigned> counts;
+			for (auto const& i: m_staged->inserts)
+				refs(counts, i.first) += i.second;
+			writeRefs(batch, counts);
+		}
+		write(batch);
+		clearStaged();
+	}
+}
+
+void OverlayDB::flush(unsigned _era, unsigned _depth)
+{
+	if (!m_db)
+		return;
+	if (!m_staged->pruning)
+	{
+		flush();
+		return;
+	}
+
+	ldb::WriteBatch batch;
+	writeStaged(batch);
+
+	std::unordered_map<h256, unsigned> counts;
+	h256s inserted;
+	for (auto const& i: m_staged->inserts)
+	{
+		refs(counts, i.first) += i.second;
+		inserted.insert(inserted.end(), i.second, i.first);
+	}
+
+	if (!inserted.empty() || !m_staged->kills.empty())
+	{
+		RLPStream journal(2);
+		journal << inserted << m_staged->kills;
+		bytes k = journalKey(_era);
+		bytes v = journal.out();
+		batch.Put(bytesConstRef(&k), bytesConstRef(&v));
+	}
+
+	// The references dropped _depth blocks ago can't be needed by a reorg anymore.
+	if (_era >= _depth)
+	{
+		std::string old;
+		bytes oldKey = journalKey(_era - _depth);
+		m_db->Get(m_readOptions, bytesConstRef(&oldKey), &old);
+		if (!old.empty())
+		{
+			release(batch, counts, RLP(old)[1].toVector<h256>());
+			batch.Delete(bytesConstRef(&oldKey));
+		}
+	}
+
+	writeRefs(batch, counts);
+	write(batch);
+	clearStaged();
+}
+
+void OverlayDB::revert(unsigned _era)
+{
+	if (!m_db || !m_staged->pruning)
+		return;
+
+	std::string j;
+	bytes k = journalKey(_era);
+	m_db->Get(m_readOptions, bytesConstRef(&k), &j);
+	if (j.empty())
+		return;
+
+	ldb::WriteBatch batch;
+	std::unordered_map<h256, unsigned> counts;
+	release(batch, counts, RLP(j)[0].toVector<h256>());
+	writeRefs(batch, counts);
+	batch.Delete(bytesConstRef(&k));
+	write(batch);
+}
+
 bytes OverlayDB::lookupAux(h256 const& _h) const
 {
 	bytes ret = MemoryDB::lookupAux(_h);
 	if (!ret.empty() || !m_db)
 		return ret;
+	DEV_READ_GUARDED(m_staged->x_staged)
+	{
+		auto it = m_staged->aux.find(_h);
+		if (it != m_staged->aux.end())
+			return it->second;
+	}
 	std::string v;
 	bytes b = _h.asBytes();
 	b.push_back(255);	// for aux
@@ -121,7 +299,15 @@ std::string OverlayDB::lookup(h256 const& _h) const
 {
 	std::string ret = MemoryDB::lookup(_h);
 	if (ret.empty() && m_db)
+	{
+		DEV_READ_GUARDED(m_staged->x_staged)
+		{
+			auto it = m_staged->main.find(_h);
+			if (it != m_staged->main.end())
+				return it->second;
+		}
 		m_db->Get(m_readOptions, ldb::Slice((char const*)_h.data(), 32), &ret);
+	}
 	return ret;
 }
 
@@ -129,6 +315,9 @@ bool OverlayDB::exists(h256 const& _h) const
 {
 	if (MemoryDB::exists(_h))
 		return true;
+	DEV_READ_GUARDED(m_staged->x_staged)
+		if (m_staged->main.count(_h))
+			return true;
 	std::string ret;
 	if (m_db)
 		m_db->Get(m_readOptions, ldb::Slice((char const*)_h.data(), 32), &ret);
@@ -140,8 +329,17 @@ void OverlayDB::kill(h256 const& _h)
 #if ETH_PARANOIA || 1
 	if (!MemoryDB::kill(_h))
 	{
+		// The reference being dropped is one counted on disk.
 		std::string ret;
-		if (m_db)
+		DEV_WRITE_GUARDED(m_staged->x_staged)
+		{
+			if (m_staged->pruning)
+				m_staged->kills.push_back(_h);
+			auto it = m_staged->main.find(_h);
+			if (it != m_staged->main.end())
+				ret = it->second;
+		}
+		if (ret.empty() && m_db)
 			m_db->Get(m_readOptions, ldb::Slice((char const*)_h.data(), 32), &ret);
 		// No point node ref decreasing for EmptyTrie since we never bother incrementing it in the first place for
 		// empty storage tries.
@@ -161,6 +359,8 @@ bool OverlayDB::deepkill(h256 const& _h)
 	kill(_h);
 
 	//kill in overlayDB
+	DEV_WRITE_GUARDED(m_staged->x_staged)
+		m_staged->main.erase(_h);
 	ldb::Status s = m_db->Delete(m_writeOptions, ldb::Slice((char const*)_h.data(), 32));
 	if (s.ok())
 		return true;
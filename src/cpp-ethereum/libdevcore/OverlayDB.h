@@ -24,6 +24,7 @@
 #include <memory>
 #include <libdevcore/db.h>
 #include <libdevcore/Common.h>
+#include <libdevcore/Guards.h>
 #include <libdevcore/Log.h>
 #include <libdevcore/MemoryDB.h>
 
@@ -41,6 +42,25 @@ public:
 	void commit();
 	void rollback();
 
+	/// Moves the referenced nodes out of memory into the staging area. Nothing is written until flush().
+	void stage();
+	/// Writes everything staged so far to the disk DB in a single batch.
+	void flush();
+
+	/// Keeps a reference count for every flushed node so unreachable nodes can be deleted.
+	/// Must be enabled before the first node is written, counts are not rebuilt for older nodes.
+	void enablePruning() { m_staged->pruning = true; }
+	bool pruning() const { return m_staged->pruning; }
+	/// Forgets the dereferences recorded since the last flush, they belong to a block that was not connected.
+	void resetJournal() { WriteGuard l(m_staged->x_staged); m_staged->kills.clear(); }
+	/// Like flush(), and with pruning also journals the references added and dropped by block _era, and
+	/// applies the dropped references journaled _depth blocks earlier, deleting nodes nothing refers to anymore.
+	void flush(unsigned _era, unsigned _depth);
+	/// Undoes the references added by the journaled block _era and forgets its dropped ones (block disconnected).
+	void revert(unsigned _era);
+	/// Approximate number of bytes waiting in the staging area.
+	size_t stagedSize() const { return m_staged->size; }
+
 	std::string lookup(h256 const& _h) const;
 	bool exists(h256 const& _h) const;
 	void kill(h256 const& _h);
@@ -53,6 +73,28 @@ private:
 
 	std::shared_ptr<ldb::DB> m_db;
 
+	struct Staged
+	{
+		std::unordered_map<h256, std::string> main;
+		std::unordered_map<h256, bytes> aux;
+		size_t size = 0;
+		bool pruning = false;
+		std::unordered_map<h256, unsigned> inserts;	///< new references to staged nodes (pruning only)
+		h256s kills;								///< references dropped from flushed nodes (pruning only)
+		/// Only the owner of the state stages and flushes, but copies opened for read-only calls
+		/// look nodes up from other threads. Writers take it exclusively when they change the maps.
+		mutable SharedMutex x_staged;
+	};
+	void writeStaged(ldb::WriteBatch& _batch);
+	void write(ldb::WriteBatch& _batch);
+	void clearStaged();
+	unsigned& refs(std::unordered_map<h256, unsigned>& _refs, h256 const& _h) const;
+	void release(ldb::WriteBatch& _batch, std::unordered_map<h256, unsigned>& _refs, h256s const& _hs) const;
+	void writeRefs(ldb::WriteBatch& _batch, std::unordered_map<h256, unsigned> const& _refs) const;
+
+	/// Shared by copies, like m_db, so every copy sees the nodes staged but not yet flushed.
+	std::shared_ptr<Staged> m_staged = std::make_shared<Staged>();
+
 	ldb::ReadOptions m_readOptions;
 	ldb::WriteOptions m_writeOptions;
 };
@@ -20,15 +20,22 @@
  */
 
 #include "SHA3.h"
+#include <algorithm>
 #include <cstdint>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <numeric>
 #include "RLP.h"
 #include "picosha2.h"
 using namespace std;
 using namespace dev;
 
+#if defined(ENABLE_AVX2) && (defined(__x86_64__) || defined(__amd64__) || defined(__i386__))
+#define SHA3_CAN_USE_AVX2
+#include <cpuid.h>
+#endif
+
 namespace dev
 {
 
@@ -209,6 +216,66 @@ defsha3(256)
 defsha3(384)
 defsha3(512)
 
+/******** Four SHA3-256 sponges side by side. ********/
+
+#ifdef SHA3_CAN_USE_AVX2
+void keccakf1600x4_avx2(uint64_t* _lanes);
+#endif
+
+/// Permutes four interleaved states, set by sha3AutoDetect(); null when there is none.
+static void (*keccakf4)(uint64_t* _lanes) = nullptr;
+
+static const size_t c_rate256 = 200 - 256 / 4;
+
+/// Hashes four inputs with one keccakf4 call per block of the longest one. A
+/// state that is already done keeps being permuted, its output is read right
+/// after its last block.
+static void sha3_256x4(bytesConstRef const* _in, h256* const* _out)
+{
+	uint64_t lanes[100] = {0};
+	size_t blocks[4];
+	size_t maxBlocks = 0;
+	for (unsigned k = 0; k < 4; ++k)
+	{
+		blocks[k] = _in[k].size() / c_rate256 + 1;
+		maxBlocks = std::max(maxBlocks, blocks[k]);
+	}
+
+	for (size_t b = 0; b < maxBlocks; ++b)
+	{
+		for (unsigned k = 0; k < 4; ++k)
+		{
+			if (b >= blocks[k])
+				continue;
+			uint8_t block[c_rate256];
+			size_t offset = b * c_rate256;
+			if (b + 1 < blocks[k])
+				memcpy(block, _in[k].data() + offset, c_rate256);
+			else
+			{
+				// Last block: the rest of the input and the padding
+				size_t rest = _in[k].size() - offset;
+				memset(block, 0, c_rate256);
+				if (rest)
+					memcpy(block, _in[k].data() + offset, rest);
+				block[rest] ^= 0x01;
+				block[c_rate256 - 1] ^= 0x80;
+			}
+			for (unsigned i = 0; i < c_rate256 / 8; ++i)
+			{
+				uint64_t word;
+				memcpy(&word, block + 8 * i, 8);
+				lanes[4 * i + k] ^= word;
+			}
+		}
+		keccakf4(lanes);
+		for (unsigned k = 0; k < 4; ++k)
+			if (b + 1 == blocks[k])
+				for (unsigned i = 0; i < 4; ++i)
+					memcpy(_out[k]->data() + 8 * i, &lanes[4 * i + k], 8);
+	}
+}
+
 }
 
 bool sha3(bytesConstRef _input, bytesRef o_output)
@@ -221,4 +288,92 @@ bool sha3(bytesConstRef _input, bytesRef o_output)
 	return true;
 }
 
+std::vector<h256> sha3Batch(std::vector<bytesConstRef> const& _inputs)
+{
+	std::vector<h256> ret(_inputs.size());
+	if (!keccak::keccakf4)
+	{
+		for (size_t i = 0; i < _inputs.size(); ++i)
+			ret[i] = sha3(_inputs[i]);
+		return ret;
+	}
+
+	// Put inputs with the same number of blocks together, so that the four
+	// sponges of a group finish at the same time.
+	std::vector<size_t> order(_inputs.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&](size_t _a, size_t _b) {
+		return _inputs[_a].size() / keccak::c_rate256 < _inputs[_b].size() / keccak::c_rate256;
+	});
+
+	h256 unused;
+	for (size_t i = 0; i < order.size(); i += 4)
+	{
+		bytesConstRef in[4];
+		h256* out[4] = {&unused, &unused, &unused, &unused};
+		for (unsigned k = 0; k < 4 && i + k < order.size(); ++k)
+		{
+			in[k] = _inputs[order[i + k]];
+			out[k] = &ret[order[i + k]];
+		}
+		if (i + 1 == order.size())
+			ret[order[i]] = sha3(in[0]);
+		else
+			keccak::sha3_256x4(in, out);
+	}
+	return ret;
+}
+
+#ifdef SHA3_CAN_USE_AVX2
+static bool haveAVX2()
+{
+	unsigned a, b, c, d;
+	if (!__get_cpuid(1, &a, &b, &c, &d))
+		return false;
+	// The CPU must support AVX and the OS must save the YMM registers (OSXSAVE + XCR0)
+	if (!((c >> 27) & 1) || !((c >> 28) & 1))
+		return false;
+	unsigned xcr0, xcr0Hi;
+	__asm__ ("xgetbv" : "=a"(xcr0), "=d"(xcr0Hi) : "c"(0));
+	if ((xcr0 & 6) != 6)
+		return false;
+	if (__get_cpuid_max(0, nullptr) < 7)
+		return false;
+	__cpuid_count(7, 0, a, b, c, d);
+	return (b >> 5) & 1;
+}
+#endif
+
+std::string sha3AutoDetect()
+{
+#ifdef SHA3_CAN_USE_AVX2
+	if (haveAVX2())
+	{
+		// Inputs around the block size, hashed both ways
+		std::vector<bytes> data;
+		for (size_t len: {0, 1, 31, 32, 135, 136, 137, 271, 272, 300, 600})
+		{
+			bytes d(len);
+			for (size_t i = 0; i < len; ++i)
+				d[i] = (byte)(i * 7 + len);
+			data.push_back(d);
+		}
+		std::vector<bytesConstRef> refs;
+		for (auto const& d: data)
+			refs.push_back(&d);
+
+		keccak::keccakf4 = keccak::keccakf1600x4_avx2;
+		std::vector<h256> batch = sha3Batch(refs);
+		for (size_t i = 0; i < refs.size(); ++i)
+			if (batch[i] != sha3(refs[i]))
+			{
+				keccak::keccakf4 = nullptr;
+				return "generic (AVX2 self-test failed)";
+			}
+		return "avx2(4way)";
+	}
+#endif
+	return "generic";
+}
+
 }
@@ -0,0 +1,101 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file SHA3_avx2.cpp
+ * @date 2018
+ *
+ * Keccak-f[1600] on four states at once, one state per 64-bit element of the
+ * AVX2 registers. Only compiled with -mavx2; sha3AutoDetect() decides at
+ * runtime whether it is used.
+ */
+
+#ifdef ENABLE_AVX2
+
+#include <cstdint>
+#include <immintrin.h>
+
+namespace dev
+{
+namespace keccak
+{
+
+static const uint64_t RC[24] =
+	{1ULL, 0x8082ULL, 0x800000000000808aULL, 0x8000000080008000ULL,
+	 0x808bULL, 0x80000001ULL, 0x8000000080008081ULL, 0x8000000000008009ULL,
+	 0x8aULL, 0x88ULL, 0x80008009ULL, 0x8000000aULL,
+	 0x8000808bULL, 0x800000000000008bULL, 0x8000000000008089ULL, 0x8000000000008003ULL,
+	 0x8000000000008002ULL, 0x8000000000000080ULL, 0x800aULL, 0x800000008000000aULL,
+	 0x8000000080008081ULL, 0x8000000000008080ULL, 0x80000001ULL, 0x8000000080008008ULL};
+
+#define ROL4(x, s) _mm256_or_si256(_mm256_slli_epi64((x), (s)), _mm256_srli_epi64((x), 64 - (s)))
+
+/// @param _lanes 25 lanes of four interleaved states: lane i of state k is _lanes[4 * i + k].
+void keccakf1600x4_avx2(uint64_t* _lanes)
+{
+	__m256i a[25];
+	__m256i b[5];
+	__m256i t;
+
+	for (int i = 0; i < 25; ++i)
+		a[i] = _mm256_loadu_si256((__m256i const*)(_lanes + 4 * i));
+
+	for (int round = 0; round < 24; ++round)
+	{
+		// Theta
+#define XOR5(x) _mm256_xor_si256(_mm256_xor_si256(_mm256_xor_si256(a[x], a[x + 5]), _mm256_xor_si256(a[x + 10], a[x + 15])), a[x + 20])
+		b[0] = XOR5(0); b[1] = XOR5(1); b[2] = XOR5(2); b[3] = XOR5(3); b[4] = XOR5(4);
+#undef XOR5
+#define THETA(x, prev, next) \
+		t = _mm256_xor_si256(b[prev], ROL4(b[next], 1)); \
+		a[x] = _mm256_xor_si256(a[x], t); a[x + 5] = _mm256_xor_si256(a[x + 5], t); a[x + 10] = _mm256_xor_si256(a[x + 10], t); \
+		a[x + 15] = _mm256_xor_si256(a[x + 15], t); a[x + 20] = _mm256_xor_si256(a[x + 20], t);
+		THETA(0, 4, 1) THETA(1, 0, 2) THETA(2, 1, 3) THETA(3, 2, 4) THETA(4, 3, 0)
+#undef THETA
+
+		// Rho and pi, with the same lane order and rotations as the portable keccakf
+		t = a[1];
+#define RHOPI(j, r) b[0] = a[j]; a[j] = ROL4(t, r); t = b[0];
+		RHOPI(10, 1) RHOPI(7, 3) RHOPI(11, 6) RHOPI(17, 10) RHOPI(18, 15) RHOPI(3, 21)
+		RHOPI(5, 28) RHOPI(16, 36) RHOPI(8, 45) RHOPI(21, 55) RHOPI(24, 2) RHOPI(4, 14)
+		RHOPI(15, 27) RHOPI(23, 41) RHOPI(19, 56) RHOPI(13, 8) RHOPI(12, 25) RHOPI(2, 43)
+		RHOPI(20, 62) RHOPI(14, 18) RHOPI(22, 39) RHOPI(9, 61) RHOPI(6, 20) RHOPI(1, 44)
+#undef RHOPI
+
+		// Chi
+#define CHI(y) \
+		b[0] = a[y]; b[1] = a[y + 1]; b[2] = a[y + 2]; b[3] = a[y + 3]; b[4] = a[y + 4]; \
+		a[y] = _mm256_xor_si256(b[0], _mm256_andnot_si256(b[1], b[2])); \
+		a[y + 1] = _mm256_xor_si256(b[1], _mm256_andnot_si256(b[2], b[3])); \
+		a[y + 2] = _mm256_xor_si256(b[2], _mm256_andnot_si256(b[3], b[4])); \
+		a[y + 3] = _mm256_xor_si256(b[3], _mm256_andnot_si256(b[4], b[0])); \
+		a[y + 4] = _mm256_xor_si256(b[4], _mm256_andnot_si256(b[0], b[1]));
+		CHI(0) CHI(5) CHI(10) CHI(15) CHI(20)
+#undef CHI
+
+		// Iota
+		a[0] = _mm256_xor_si256(a[0], _mm256_set1_epi64x((long long)RC[round]));
+	}
+
+	for (int i = 0; i < 25; ++i)
+		_mm256_storeu_si256((__m256i*)(_lanes + 4 * i), a[i]);
+}
+
+#undef ROL4
+
+}
+}
+
+#endif // ENABLE_AVX2
@@ -334,6 +334,10 @@ public:
 	void insert(KeyType _k, bytes const& _value) { insert(_k, bytesConstRef(&_value)); }
 	void remove(KeyType _k) { Generic::remove(bytesConstRef((byte const*)&_k, sizeof(KeyType))); }
 
+	/// For hashed tries: insert/remove with the key's hash already known, see sha3Batch().
+	void insertHashed(h256 const& _hash, KeyType _k, bytesConstRef _value) { Generic::insertHashed(_hash, bytesConstRef((byte const*)&_k, sizeof(KeyType)), _value); }
+	void removeHashed(h256 const& _hash) { Generic::removeHashed(_hash); }
+
 	class iterator: public Generic::iterator
 	{
 	public:
@@ -395,6 +399,10 @@ public:
 	void insert(bytesConstRef _key, bytesConstRef _value) { Super::insert(sha3(_key), _value); }
 	void remove(bytesConstRef _key) { Super::remove(sha3(_key)); }
 
+	/// insert() and remove() for a key whose hash @a _hash is already known.
+	void insertHashed(h256 const& _hash, bytesConstRef, bytesConstRef _value) { Super::insert(_hash, _value); }
+	void removeHashed(h256 const& _hash) { Super::remove(_hash); }
+
 	// empty from the PoV of the iterator interface; still need a basic iterator impl though.
 	class iterator
 	{
@@ -452,6 +460,14 @@ public:
 
 	void remove(bytesConstRef _key) { Super::remove(sha3(_key)); }
 
+	/// insert() and remove() for a key whose hash @a _hash is already known.
+	void insertHashed(h256 const& _hash, bytesConstRef _key, bytesConstRef _value)
+	{
+		Super::insert(_hash, _value);
+		Super::db()->insertAux(_hash, _key);
+	}
+	void removeHashed(h256 const& _hash) { Super::remove(_hash); }
+
 	// iterates over <key, value> pairs
 	class iterator: public GenericTrieDB<_DB>::iterator
 	{
@@ -104,22 +104,37 @@ void hash256rlp(HexMap const& _s, HexMap::const_iterator _begin, HexMap::const_i
 #endif
 				++b;
 			}
+			// Build all children first so that the ones referenced by hash
+			// are hashed together.
+			std::vector<bytes> children(16);
+			std::vector<bytesConstRef> toHash;
 			for (auto i = 0; i < 16; ++i)
 			{
 				auto n = b;
 				for (; n != _end && n->first[_preLen] == i; ++n) {}
-				if (b == n)
-					_rlp << "";
-				else
+				if (b != n)
 				{
 #if ENABLE_DEBUG_PRINT
 					if (g_hashDebug)
 						std::cerr << s_indent << std::hex << i << ": " << std::dec << std::endl;
 #endif
-					hash256aux(_s, b, n, _preLen + 1, _rlp);
+					RLPStream rlp;
+					hash256rlp(_s, b, n, _preLen + 1, rlp);
+					rlp.swapOut(children[i]);
+					if (children[i].size() >= 32)
+						toHash.push_back(&children[i]);
 				}
 				b = n;
 			}
+			std::vector<h256> hashes = sha3Batch(toHash);
+			size_t h = 0;
+			for (auto const& child: children)
+				if (child.empty())
+					_rlp << "";
+				else if (child.size() < 32)
+					_rlp.APPEND_CHILD(child);
+				else
+					_rlp << hashes[h++];
 			if (_preLen == _begin->first.size())
 				_rlp << _begin->second;
 			else
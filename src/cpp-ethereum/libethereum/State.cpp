@@ -32,6 +32,7 @@
 #include <libevmcore/Instruction.h>
 #include <libethcore/Exceptions.h>
 #include <libevm/VMFactory.h>
+#include <libevm/CodeCache.h>
 #include "BlockChain.h"
 #include "CodeSizeCache.h"
 #include "Defaults.h"
@@ -68,6 +69,7 @@ State::State(State const& _s):
 	m_unchangedCacheEntries(_s.m_unchangedCacheEntries),
 	m_nonExistingAccountsCache(_s.m_nonExistingAccountsCache),
 	m_touched(_s.m_touched),
+	m_stateCache(_s.m_stateCache),
 	m_accountStartNonce(_s.m_accountStartNonce)
 {}
 
@@ -151,6 +153,7 @@ State& State::operator=(State const& _s)
 	m_unchangedCacheEntries = _s.m_unchangedCacheEntries;
 	m_nonExistingAccountsCache = _s.m_nonExistingAccountsCache;
 	m_touched = _s.m_touched;
+	m_stateCache = _s.m_stateCache;
 	m_accountStartNonce = _s.m_accountStartNonce;
 	return *this;
 }
@@ -170,8 +173,23 @@ Account* State::account(Address const& _addr)
 		return nullptr;
 
 	// Populate basic info.
-	string stateBack = m_state.at(_addr);
-	if (stateBack.empty())
+	CachedAccount cached;
+	if (!m_stateCache || !m_stateCache->account(m_state.root(), _addr, cached))
+	{
+		string stateBack = m_state.at(_addr);
+		if (!stateBack.empty())
+		{
+			RLP state(stateBack);
+			cached.exists = true;
+			cached.nonce = state[0].toInt<u256>();
+			cached.balance = state[1].toInt<u256>();
+			cached.storageRoot = state[2].toHash<h256>();
+			cached.codeHash = state[3].toHash<h256>();
+		}
+		if (m_stateCache)
+			m_stateCache->noteAccount(m_state.root(), _addr, cached);
+	}
+	if (!cached.exists)
 	{
 		m_nonExistingAccountsCache.insert(_addr);
 		return nullptr;
@@ -179,11 +197,10 @@ Account* State::account(Address const& _addr)
 
 	clearCacheIfTooLarge();
 
-	RLP state(stateBack);
 	auto i = m_cache.emplace(
 		std::piecewise_construct,
 		std::forward_as_tuple(_addr),
-		std::forward_as_tuple(state[0].toInt<u256>(), state[1].toInt<u256>(), state[2].toHash<h256>(), state[3].toHash<h256>(), Account::Unchanged)
+		std::forward_as_tuple(cached.nonce, cached.balance, cached.storageRoot, cached.codeHash, Account::Unchanged)
 	);
 	m_unchangedCacheEntries.push_back(_addr);
 	return &i.first->second;
@@ -211,7 +228,7 @@ void State::commit(CommitBehaviour _commitBehaviour)
 {
 	if (_commitBehaviour == CommitBehaviour::RemoveEmptyAccounts)
 		removeEmptyAccounts();
-	m_touched += dev::eth::commit(m_cache, m_state);
+	m_touched += dev::eth::commit(m_cache, m_state, m_stateCache.get());
 	m_changeLog.clear();
 	m_cache.clear();
 	m_unchangedCacheEntries.clear();
@@ -358,10 +375,16 @@ u256 State::storage(Address const& _id, u256 const& _key) const
 		if (mit != a->storageOverlay().end())
 			return mit->second;
 
-		// Not in the storage cache - go to the DB.
-		SecureTrieDB<h256, OverlayDB> memdb(const_cast<OverlayDB*>(&m_db), a->baseRoot());			// promise we won't change the overlay! :)
-		string payload = memdb.at(_key);
-		u256 ret = payload.size() ? RLP(payload).toInt<u256>() : 0;
+		// Not in the storage cache - try the committed slots, then go to the DB.
+		u256 ret;
+		if (!m_stateCache || !m_stateCache->storage(a->baseRoot(), _key, ret))
+		{
+			SecureTrieDB<h256, OverlayDB> memdb(const_cast<OverlayDB*>(&m_db), a->baseRoot());			// promise we won't change the overlay! :)
+			string payload = memdb.at(_key);
+			ret = payload.size() ? RLP(payload).toInt<u256>() : 0;
+			if (m_stateCache)
+				m_stateCache->noteStorage(a->baseRoot(), _key, ret);
+		}
 		a->setStorageCache(_key, ret);
 		return ret;
 	}
@@ -428,9 +451,12 @@ bytes const& State::code(Address const& _addr) const
 
 	if (a->code().empty())
 	{
-		// Load the code from the backend.
+		// Load the code from the backend, unless the interpreter still has it.
 		Account* mutableAccount = const_cast<Account*>(a);
-		mutableAccount->noteCode(m_db.lookup(a->codeHash()));
+		if (auto cached = CodeCache::instance().code(a->codeHash()))
+			mutableAccount->noteCode(&cached->code);
+		else
+			mutableAccount->noteCode(m_db.lookup(a->codeHash()));
 		CodeSizeCache::instance().store(a->codeHash(), a->code().size());
 	}
 
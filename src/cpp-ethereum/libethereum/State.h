@@ -30,6 +30,7 @@
 #include <libethcore/Exceptions.h>
 #include <libethcore/BlockHeader.h>
 #include <libethereum/CodeSizeCache.h>
+#include <libethereum/StateCache.h>
 #include <libethereum/GenericMiner.h>
 #include <libevm/ExtVMFace.h>
 #include "Account.h"
@@ -294,6 +295,10 @@ public:
 	/// Resets any uncommitted changes to the cache.
 	void setRoot(h256 const& _root);
 
+	/// Shares @a _cache of committed accounts and storage with other states on the same database.
+	void setStateCache(std::shared_ptr<StateCache> const& _cache) { m_stateCache = _cache; }
+	std::shared_ptr<StateCache> const& stateCache() const { return m_stateCache; }
+
 	/// Get the account start nonce. May be required.
 	u256 const& accountStartNonce() const { return m_accountStartNonce; }
 	u256 const& requireAccountStartNonce() const;
@@ -332,6 +337,7 @@ protected: // lux
 	mutable std::vector<Address> m_unchangedCacheEntries;	///< Tracks entries in m_cache that can potentially be purged if it grows too large.
 	mutable std::set<Address> m_nonExistingAccountsCache;	///< Tracks addresses that are known to not exist.
 	AddressHash m_touched;						///< Tracks all addresses touched so far.
+	std::shared_ptr<StateCache> m_stateCache;	///< Committed accounts and storage kept across commits and roots, may be null.
 
 	u256 m_accountStartNonce;
 
@@ -342,12 +348,15 @@ protected: // lux
 std::ostream& operator<<(std::ostream& _out, State const& _s);
 
 template <class DB>
-AddressHash commit(AccountMap const& _cache, SecureTrieDB<Address, DB>& _state)
+AddressHash commit(AccountMap const& _cache, SecureTrieDB<Address, DB>& _state, StateCache* _stateCache = nullptr)
 {
 	AddressHash ret;
+	h256 const from = _state.root();
+	std::vector<std::pair<Address, CachedAccount>> written;
 	for (auto const& i: _cache)
 		if (i.second.isDirty())
 		{
+			CachedAccount cached;
 			if (!i.second.isAlive())
 				_state.remove(i.first);
 			else
@@ -359,17 +368,44 @@ AddressHash commit(AccountMap const& _cache, SecureTrieDB<Address, DB>& _state)
 				{
 					assert(i.second.baseRoot());
 					s.append(i.second.baseRoot());
+					cached.storageRoot = i.second.baseRoot();
 				}
 				else
 				{
 					SecureTrieDB<h256, DB> storageDB(_state.db(), i.second.baseRoot());
+
+					// Hash all the storage keys at once instead of one per insert
+					std::vector<h256> keys;
+					keys.reserve(i.second.storageOverlay().size());
 					for (auto const& j: i.second.storageOverlay())
+						keys.push_back(h256(j.first));
+					std::vector<bytesConstRef> keyRefs;
+					keyRefs.reserve(keys.size());
+					for (auto const& k: keys)
+						keyRefs.push_back(k.ref());
+					std::vector<h256> hashedKeys = sha3Batch(keyRefs);
+
+					size_t k = 0;
+					for (auto const& j: i.second.storageOverlay())
+					{
 						if (j.second)
-							storageDB.insert(j.first, rlp(j.second));
+						{
+							bytes value = rlp(j.second);
+							storageDB.insertHashed(hashedKeys[k], keys[k], &value);
+						}
 						else
-							storageDB.remove(j.first);
+							storageDB.removeHashed(hashedKeys[k]);
+						++k;
+					}
 					assert(storageDB.root());
 					s.append(storageDB.root());
+					cached.storageRoot = storageDB.root();
+
+					if (_stateCache)
+					{
+						std::vector<std::pair<u256, u256>> slots(i.second.storageOverlay().begin(), i.second.storageOverlay().end());
+						_stateCache->noteStorageCommit(i.second.baseRoot(), storageDB.root(), slots);
+					}
 				}
 
 				if (i.second.hasNewCode())
@@ -379,14 +415,26 @@ AddressHash commit(AccountMap const& _cache, SecureTrieDB<Address, DB>& _state)
 					CodeSizeCache::instance().store(ch, i.second.code().size());
 					_state.db()->insert(ch, &i.second.code());
 					s << ch;
+					cached.codeHash = ch;
 				}
 				else
+				{
 					s << i.second.codeHash();
+					cached.codeHash = i.second.codeHash();
+				}
 
 				_state.insert(i.first, &s.out());
+
+				cached.exists = true;
+				cached.nonce = i.second.nonce();
+				cached.balance = i.second.balance();
 			}
+			if (_stateCache)
+				written.emplace_back(i.first, cached);
 			ret.insert(i.first);
 		}
+	if (_stateCache)
+		_stateCache->noteCommit(from, _state.root(), written);
 	return ret;
 }
 
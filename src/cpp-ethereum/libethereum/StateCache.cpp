@@ -0,0 +1,113 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file StateCache.cpp
+ * @date 2018
+ */
+
+#include "StateCache.h"
+#include <libdevcore/TrieDB.h>
+using namespace std;
+using namespace dev;
+using namespace dev::eth;
+
+bool StateCache::account(h256 const& _stateRoot, Address const& _address, CachedAccount& o_account)
+{
+	UniqueGuard g(x_cache);
+	bool ret = m_accounts.get(_stateRoot, _address, o_account);
+	if (ret)
+		shrink();
+	return ret;
+}
+
+void StateCache::noteAccount(h256 const& _stateRoot, Address const& _address, CachedAccount const& _account)
+{
+	UniqueGuard g(x_cache);
+	m_accounts.insert(_stateRoot, _address, _account);
+	shrink();
+}
+
+bool StateCache::storage(h256 const& _storageRoot, u256 const& _key, u256& o_value)
+{
+	// Nothing is stored in an empty trie
+	if (_storageRoot == EmptyTrie)
+	{
+		o_value = 0;
+		return true;
+	}
+	UniqueGuard g(x_cache);
+	bool ret = m_storage.get(_storageRoot, _key, o_value);
+	if (ret)
+		shrink();
+	return ret;
+}
+
+void StateCache::noteStorage(h256 const& _storageRoot, u256 const& _key, u256 const& _value)
+{
+	UniqueGuard g(x_cache);
+	m_storage.insert(_storageRoot, _key, _value);
+	shrink();
+}
+
+void StateCache::noteStorageCommit(h256 const& _from, h256 const& _to, vector<pair<u256, u256>> const& _slots)
+{
+	set<u256> changed;
+	for (auto const& i: _slots)
+		changed.insert(i.first);
+
+	UniqueGuard g(x_cache);
+	m_storage.link(_to, _from, move(changed));
+	for (auto const& i: _slots)
+		m_storage.insert(_to, i.first, i.second);
+	shrink();
+}
+
+void StateCache::noteCommit(h256 const& _from, h256 const& _to, vector<pair<Address, CachedAccount>> const& _accounts)
+{
+	set<Address> changed;
+	for (auto const& i: _accounts)
+		changed.insert(i.first);
+
+	UniqueGuard g(x_cache);
+	m_accounts.link(_to, _from, move(changed));
+	for (auto const& i: _accounts)
+		m_accounts.insert(_to, i.first, i.second);
+	shrink();
+}
+
+void StateCache::shrink()
+{
+	// Storage slots outnumber accounts by far
+	m_accounts.shrink(m_maxBytes / 4);
+	m_storage.shrink(m_maxBytes - m_maxBytes / 4);
+}
+
+StateCacheStats StateCache::stats() const
+{
+	UniqueGuard g(x_cache);
+	StateCacheStats ret;
+	ret.accounts = m_accounts.entries();
+	ret.slots = m_storage.entries();
+	ret.links = m_accounts.links() + m_storage.links();
+	ret.bytes = m_accounts.bytes() + m_storage.bytes();
+	ret.maxBytes = m_maxBytes;
+	ret.accountHits = m_accounts.hits;
+	ret.accountMisses = m_accounts.misses;
+	ret.slotHits = m_storage.hits;
+	ret.slotMisses = m_storage.misses;
+	ret.evictions = m_accounts.evictions + m_storage.evictions;
+	return ret;
+}
@@ -0,0 +1,219 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file StateCache.h
+ * @date 2018
+ */
+
+#pragma once
+
+#include <list>
+#include <map>
+#include <set>
+#include <utility>
+#include <vector>
+#include <libdevcore/Common.h>
+#include <libdevcore/FixedHash.h>
+#include <libdevcore/Guards.h>
+#include <libethcore/Common.h>
+
+namespace dev
+{
+namespace eth
+{
+
+/// An account record as stored in the state trie, or the fact that there is none.
+struct CachedAccount
+{
+	bool exists = false;
+	u256 nonce;
+	u256 balance;
+	h256 storageRoot;
+	h256 codeHash;
+};
+
+struct StateCacheStats
+{
+	size_t accounts = 0;        ///< Account records held.
+	size_t slots = 0;           ///< Storage slots held.
+	size_t links = 0;           ///< Commits remembered for looking through to older roots.
+	size_t bytes = 0;
+	size_t maxBytes = 0;
+	uint64_t accountHits = 0;
+	uint64_t accountMisses = 0;
+	uint64_t slotHits = 0;
+	uint64_t slotMisses = 0;
+	uint64_t evictions = 0;
+};
+
+namespace detail
+{
+
+/**
+ * @brief Values of a family of tries keyed by (trie root, key), least recently used dropped first.
+ * A commit from one root to another is remembered as a link together with the keys it
+ * changed, so a key the commit did not touch is looked up again under the older root.
+ * Not thread-safe, StateCache does the locking.
+ */
+template <class Key, class Value>
+class RootVersionedCache
+{
+public:
+	/// @returns true and sets @a o_value if the value of @a _key in the trie @a _root is known.
+	bool get(h256 const& _root, Key const& _key, Value& o_value)
+	{
+		h256 root = _root;
+		for (unsigned depth = 0; depth <= c_maxLinkDepth; ++depth)
+		{
+			auto it = m_index.find(std::make_pair(root, _key));
+			if (it != m_index.end())
+			{
+				m_lru.splice(m_lru.begin(), m_lru, it->second);
+				o_value = it->second->second;
+				// Found through older roots, keep it under the root asked for as well
+				if (depth)
+					insert(_root, _key, o_value);
+				++hits;
+				return true;
+			}
+			auto l = m_links.find(root);
+			if (l == m_links.end() || l->second.changed.count(_key))
+				break;
+			root = l->second.parent;
+		}
+		++misses;
+		return false;
+	}
+
+	void insert(h256 const& _root, Key const& _key, Value const& _value)
+	{
+		auto k = std::make_pair(_root, _key);
+		auto it = m_index.find(k);
+		if (it != m_index.end())
+		{
+			it->second->second = _value;
+			m_lru.splice(m_lru.begin(), m_lru, it->second);
+			return;
+		}
+		m_lru.emplace_front(k, _value);
+		m_index[k] = m_lru.begin();
+		m_bytes += c_entryBytes;
+	}
+
+	/// Notes that the trie @a _root was made from @a _parent by writing @a _changed.
+	void link(h256 const& _root, h256 const& _parent, std::set<Key>&& _changed)
+	{
+		if (_root == _parent || m_links.count(_root))
+			return;
+		size_t size = c_linkBytes + _changed.size() * c_keyBytes;
+		m_links[_root] = Link{_parent, std::move(_changed), size};
+		m_linkOrder.push_back(_root);
+		m_bytes += size;
+		m_linkBytes += size;
+	}
+
+	/// Drops the oldest links beyond a quarter of @a _maxBytes, then entries until at most @a _maxBytes are used.
+	void shrink(size_t _maxBytes)
+	{
+		while (m_linkBytes > _maxBytes / 4)
+		{
+			auto l = m_links.find(m_linkOrder.front());
+			m_linkBytes -= l->second.bytes;
+			m_bytes -= l->second.bytes;
+			m_links.erase(l);
+			m_linkOrder.pop_front();
+		}
+		while (m_bytes > _maxBytes && !m_lru.empty())
+		{
+			m_index.erase(m_lru.back().first);
+			m_lru.pop_back();
+			m_bytes -= c_entryBytes;
+			++evictions;
+		}
+	}
+
+	size_t entries() const { return m_index.size(); }
+	size_t links() const { return m_links.size(); }
+	size_t bytes() const { return m_bytes; }
+
+	uint64_t hits = 0;
+	uint64_t misses = 0;
+	uint64_t evictions = 0;
+
+private:
+	typedef std::pair<h256, Key> EntryKey;
+	typedef std::pair<EntryKey, Value> Entry;
+
+	struct Link
+	{
+		h256 parent;
+		std::set<Key> changed;
+		size_t bytes;
+	};
+
+	/// Rough heap use of one entry: the list node, the map node and their payloads.
+	static const size_t c_entryBytes = sizeof(Entry) + sizeof(EntryKey) + 8 * sizeof(void*);
+	static const size_t c_keyBytes = sizeof(Key) + 4 * sizeof(void*);
+	static const size_t c_linkBytes = sizeof(Link) + sizeof(h256) * 2 + 8 * sizeof(void*);
+	/// Links followed by one lookup. A block commits once per transaction.
+	static const unsigned c_maxLinkDepth = 64;
+
+	std::list<Entry> m_lru;     ///< Most recently used first.
+	std::map<EntryKey, typename std::list<Entry>::iterator> m_index;
+	std::map<h256, Link> m_links;
+	std::list<h256> m_linkOrder;    ///< Oldest link first.
+	size_t m_bytes = 0;
+	size_t m_linkBytes = 0;
+};
+
+}
+
+/**
+ * @brief Thread-safe cache of committed account records and storage slots, kept across blocks.
+ * Accounts are keyed by state root and storage slots by the account's storage root. A root
+ * fixes the content of its trie, so nothing is invalidated when a state moves to another root
+ * on a reorg or for a temporary execution; lookups under a root the cache has not seen miss.
+ * States on any root of the same database may share one cache.
+ */
+class StateCache
+{
+public:
+	explicit StateCache(size_t _maxBytes): m_maxBytes(_maxBytes) {}
+
+	bool account(h256 const& _stateRoot, Address const& _address, CachedAccount& o_account);
+	void noteAccount(h256 const& _stateRoot, Address const& _address, CachedAccount const& _account);
+
+	bool storage(h256 const& _storageRoot, u256 const& _key, u256& o_value);
+	void noteStorage(h256 const& _storageRoot, u256 const& _key, u256 const& _value);
+
+	/// Records the storage trie of one account moving from @a _from to @a _to by writing @a _slots.
+	void noteStorageCommit(h256 const& _from, h256 const& _to, std::vector<std::pair<u256, u256>> const& _slots);
+	/// Records the state trie moving from @a _from to @a _to by writing @a _accounts.
+	void noteCommit(h256 const& _from, h256 const& _to, std::vector<std::pair<Address, CachedAccount>> const& _accounts);
+
+	StateCacheStats stats() const;
+
+private:
+	void shrink();
+
+	size_t const m_maxBytes;
+	mutable Mutex x_cache;
+	detail::RootVersionedCache<Address, CachedAccount> m_accounts;
+	detail::RootVersionedCache<u256, u256> m_storage;
+};
+
+}
+}
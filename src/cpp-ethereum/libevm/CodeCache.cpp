@@ -0,0 +1,95 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file CodeCache.cpp
+ * @date 2018
+ */
+
+#include "CodeCache.h"
+using namespace std;
+using namespace dev;
+using namespace dev::eth;
+
+CodeCache& CodeCache::instance()
+{
+	static CodeCache cache;
+	return cache;
+}
+
+shared_ptr<AnalyzedCode const> CodeCache::lookup(h256 const& _hash)
+{
+	auto it = m_index.find(_hash);
+	if (it == m_index.end())
+		return nullptr;
+	m_lru.splice(m_lru.begin(), m_lru, it->second);
+	return it->second->second;
+}
+
+shared_ptr<AnalyzedCode const> CodeCache::get(h256 const& _hash)
+{
+	UniqueGuard g(x_cache);
+	auto ret = lookup(_hash);
+	if (ret)
+		++m_stats.hits;
+	else
+		++m_stats.misses;
+	return ret;
+}
+
+shared_ptr<AnalyzedCode const> CodeCache::code(h256 const& _hash)
+{
+	UniqueGuard g(x_cache);
+	auto ret = lookup(_hash);
+	if (ret)
+		++m_stats.codeHits;
+	else
+		++m_stats.codeMisses;
+	return ret;
+}
+
+void CodeCache::store(h256 const& _hash, shared_ptr<AnalyzedCode const> const& _code)
+{
+	size_t size = _code->memoryUsage();
+	if (size > c_maxBytes)
+		return;
+
+	UniqueGuard g(x_cache);
+	// Another thread may have analysed the same code in the meantime
+	if (m_index.count(_hash))
+		return;
+	m_lru.emplace_front(_hash, _code);
+	m_index[_hash] = m_lru.begin();
+	m_bytes += size;
+
+	while (m_bytes > c_maxBytes)
+	{
+		Entry const& last = m_lru.back();
+		m_bytes -= last.second->memoryUsage();
+		m_index.erase(last.first);
+		m_lru.pop_back();
+		++m_stats.evictions;
+	}
+}
+
+CodeCacheStats CodeCache::stats() const
+{
+	UniqueGuard g(x_cache);
+	CodeCacheStats ret = m_stats;
+	ret.entries = m_index.size();
+	ret.bytes = m_bytes;
+	ret.maxBytes = c_maxBytes;
+	return ret;
+}
@@ -0,0 +1,97 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file CodeCache.h
+ * @date 2018
+ */
+
+#pragma once
+
+#include <list>
+#include <map>
+#include <memory>
+#include <vector>
+#include <libdevcore/Common.h>
+#include <libdevcore/FixedHash.h>
+#include <libdevcore/Guards.h>
+
+namespace dev
+{
+namespace eth
+{
+
+/**
+ * @brief Contract code together with the result of the interpreter's first pass over it.
+ * Only depends on the code, so it is shared by every VM running the same code hash.
+ */
+struct AnalyzedCode
+{
+	bytes code;                         ///< The code as deployed.
+	bytes optimizedCode;                ///< Code after the first pass, zero padded to read past the end.
+	std::vector<uint64_t> jumpDests;    ///< Sorted positions of JUMPDEST.
+	std::vector<uint64_t> beginSubs;
+	u256 pool[256];                     ///< Constants referenced by PUSHC.
+
+	size_t memoryUsage() const
+	{
+		return sizeof(*this) + code.size() + optimizedCode.size() + (jumpDests.size() + beginSubs.size()) * sizeof(uint64_t);
+	}
+};
+
+struct CodeCacheStats
+{
+	size_t entries = 0;
+	size_t bytes = 0;
+	size_t maxBytes = 0;
+	uint64_t hits = 0;          ///< VM runs that reused an analysis.
+	uint64_t misses = 0;        ///< VM runs that analysed the code.
+	uint64_t codeHits = 0;      ///< Code loads served without a state database lookup.
+	uint64_t codeMisses = 0;
+	uint64_t evictions = 0;
+};
+
+/**
+ * @brief Thread-safe cache from code hash to analysed code, shared by all executions and kept
+ * across blocks. Bounded by memory use, the least recently used entry is removed first.
+ */
+class CodeCache
+{
+public:
+	/// Analysis for the VM, counted as a hit or a miss.
+	std::shared_ptr<AnalyzedCode const> get(h256 const& _hash);
+	/// Raw code for State::code(), counted as a code hit or miss.
+	std::shared_ptr<AnalyzedCode const> code(h256 const& _hash);
+	void store(h256 const& _hash, std::shared_ptr<AnalyzedCode const> const& _code);
+
+	CodeCacheStats stats() const;
+
+	static CodeCache& instance();
+
+private:
+	typedef std::pair<h256, std::shared_ptr<AnalyzedCode const>> Entry;
+
+	std::shared_ptr<AnalyzedCode const> lookup(h256 const& _hash);
+
+	static const size_t c_maxBytes = 32 * 1024 * 1024;
+	mutable Mutex x_cache;
+	std::list<Entry> m_lru;     ///< Most recently used first.
+	std::map<h256, std::list<Entry>::iterator> m_index;
+	size_t m_bytes = 0;
+	CodeCacheStats m_stats;
+};
+
+}
+}
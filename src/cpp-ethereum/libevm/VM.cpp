@@ -27,6 +27,22 @@ using namespace dev;
 using namespace dev::eth;
 
 
+std::string VM::configuration()
+{
+#if EVM_JUMP_DISPATCH
+	std::string config = "jump table";
+#else
+	std::string config = "switch";
+#endif
+#if EVM_USE_CONSTANT_POOL
+	config += ", constant pool";
+#endif
+#if EVM_REPLACE_CONST_JUMP
+	config += ", constant jumps";
+#endif
+	return config;
+}
+
 uint64_t VM::memNeed(u256 _offset, u256 _size)
 {
 	return toInt63(_size ? u512(_offset) + _size : u512(0));
@@ -818,7 +834,7 @@ void VM::interpretCases()
 
 		CASE(PUSHC)
 		{
-#ifdef EVM_USE_CONSTANT_POOL
+#if EVM_USE_CONSTANT_POOL
 			ON_OP();
 			updateIOGas();
 
@@ -982,7 +998,7 @@ void VM::interpretCases()
 
 		CASE(JUMPC)
 		{
-#ifdef EVM_REPLACE_CONST_JUMP
+#if EVM_REPLACE_CONST_JUMP
 			ON_OP();
 			updateIOGas();
 
@@ -996,7 +1012,7 @@ void VM::interpretCases()
 
 		CASE(JUMPCI)
 		{
-#ifdef EVM_REPLACE_CONST_JUMP
+#if EVM_REPLACE_CONST_JUMP
 			ON_OP();
 			updateIOGas();
 
@@ -28,6 +28,7 @@
 #include <libdevcore/SHA3.h>
 #include <libethcore/BlockHeader.h>
 #include "VMFace.h"
+#include "CodeCache.h"
 
 namespace dev
 {
@@ -71,6 +72,9 @@ public:
 	bytes const& memory() const { return m_mem; }
 	u256s stack() const { assert(m_stack <= m_SP + 1); return u256s(m_stack, m_SP + 1); };
 
+	/// Dispatch and optimization settings this interpreter was built with (see VMConfig.h).
+	static std::string configuration();
+
 private:
 
 	u256* io_gas = 0;
@@ -81,7 +85,6 @@ private:
 	static std::array<InstructionMetric, 256> c_metrics;
 	static void initMetrics();
 	static u256 exp256(u256 _base, u256 _exponent);
-	void copyCode(int);
 	const void* const* c_jumpTable = 0;
 	bool m_caseInit = false;
 	
@@ -97,9 +100,10 @@ private:
 	// space for memory
 	bytes m_mem;
 
-	// space for code and pointer to data
-	bytes m_codeSpace;
-	byte* m_code = nullptr;
+	// analysed code, shared with other VMs through CodeCache, and pointers to its data
+	std::shared_ptr<AnalyzedCode const> m_analysis;
+	byte const* m_code = nullptr;
+	u256 const* m_pool = nullptr;
 
 	// space for stack and pointer to data
 	u256 m_stackSpace[1025];
@@ -115,9 +119,6 @@ private:
 	std::vector<size_t> m_frameSize;
 #endif
 
-	// constant pool
-	u256 m_pool[256];
-
 	// interpreter state
 	Instruction m_OP;                   // current operator
 	uint64_t    m_PC = 0;               // program counter
@@ -153,8 +154,6 @@ private:
 
 	void reportStackUse();
 
-	std::vector<uint64_t> m_beginSubs;
-	std::vector<uint64_t> m_jumpDests;
 	int64_t verifyJumpDest(u256 const& _dest, bool _throw = true);
 
 	int poolConstant(const u256&);
@@ -32,6 +32,11 @@ namespace eth
 // EVM_REPLACE_CONST_JUMP - with pre-verified jumps to save runtime lookup
 //
 // EVM_TRACE              - provides various levels of tracing
+//
+// All of them can be set at build time, e.g. CPPFLAGS=-DEVM_JUMP_DISPATCH=true
+// gives the jump table interpreter on GCC. The switch stays the default, as it
+// measured faster with the constant pool. Every combination charges the same
+// gas and gives the same results, only the speed differs.
 
 #ifndef EVM_JUMP_DISPATCH
 	#ifdef __GNUC__
@@ -52,12 +57,19 @@ namespace eth
 	#define EVM_OPTIMIZE true
 #endif
 #if EVM_OPTIMIZE
-	#define EVM_REPLACE_CONST_JUMP true
-	#define EVM_USE_CONSTANT_POOL false
+	#ifndef EVM_REPLACE_CONST_JUMP
+		#define EVM_REPLACE_CONST_JUMP true
+	#endif
+	#ifndef EVM_USE_CONSTANT_POOL
+		#define EVM_USE_CONSTANT_POOL true
+	#endif
 	#define EVM_DO_FIRST_PASS_OPTIMIZATION ( \
 				EVM_REPLACE_CONST_JUMP || \
 				EVM_USE_CONSTANT_POOL \
 			)
+#else
+	#undef EVM_REPLACE_CONST_JUMP
+	#undef EVM_USE_CONSTANT_POOL
 #endif
 
 #define EVM_JUMPS_AND_SUBS false
@@ -219,16 +231,16 @@ namespace eth
 			&&NUMBER,  \
 			&&DIFFICULTY,  \
 			&&GASLIMIT,  \
+			&&INVALID,  \
+			&&INVALID,  \
+			&&INVALID,  \
+			&&INVALID,  \
 			&&JUMPTO,  \
 			&&JUMPIF,  \
 			&&JUMPV,  \
 			&&JUMPSUB,  \
 			&&JUMPSUBV,  \
 			&&RETURNSUB,  \
-			&&BEGINSUB,  \
-			&&BEGINDATA,  \
-			&&INVALID,  \
-			&&INVALID,  \
 			&&POP,           /* 50, */  \
 			&&MLOAD,  \
 			&&MSTORE,  \
@@ -241,8 +253,8 @@ namespace eth
 			&&MSIZE,  \
 			&&GAS,  \
 			&&JUMPDEST,  \
-			&&BEGINDATA,  \
 			&&BEGINSUB,  \
+			&&BEGINDATA,  \
 			&&INVALID,  \
 			&&INVALID,  \
 			&&PUSH1,         /* 60, */  \
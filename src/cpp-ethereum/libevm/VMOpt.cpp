@@ -35,8 +35,8 @@ void VM::reportStackUse()
 std::array<InstructionMetric, 256> VM::c_metrics;
 void VM::initMetrics()
 {
-	static bool done=false;
-	if (!done)
+	// Filled once, also when the first VMs start on several threads at once
+	static bool const done = []()
 	{
 		for (unsigned i = 0; i < 256; ++i)
 		{
@@ -45,25 +45,23 @@ void VM::initMetrics()
 			c_metrics[i].args = op.args;
 			c_metrics[i].ret = op.ret;
 		}
-	}
-	done = true;
+		return true;
+	}();
+	(void)done;
 }
 
-void VM::copyCode(int _extraBytes)
+void VM::optimize()
 {
 	// Copy code so that it can be safely modified and extend code by
-	// _extraBytes zero bytes to allow reading virtual data at the end
+	// 33 zero bytes to allow reading virtual data at the end
 	// of the code without bounds checks.
-	auto extendedSize = m_ext->code.size() + _extraBytes;
-	m_codeSpace.reserve(extendedSize);
-	m_codeSpace = m_ext->code;
-	m_codeSpace.resize(extendedSize);
-	m_code = m_codeSpace.data();
-}
-
-void VM::optimize()
-{
-	copyCode(33);
+	auto analysis = make_shared<AnalyzedCode>();
+	analysis->code = m_ext->code;
+	analysis->optimizedCode.reserve(m_ext->code.size() + 33);
+	analysis->optimizedCode = m_ext->code;
+	analysis->optimizedCode.resize(m_ext->code.size() + 33);
+	m_analysis = analysis;
+	byte* code = analysis->optimizedCode.data();
 
 	size_t const nBytes = m_ext->code.size();
 
@@ -72,7 +70,7 @@ void VM::optimize()
 	TRACE_STR(1, "Build JUMPDEST table")
 	for (size_t pc = 0; pc < nBytes; ++pc)
 	{
-		Instruction op = Instruction(m_code[pc]);
+		Instruction op = Instruction(code[pc]);
 		TRACE_OP(2, pc, op);
 				
 		// make synthetic ops in user code trigger invalid instruction if run
@@ -83,12 +81,12 @@ void VM::optimize()
 		)
 		{
 			TRACE_OP(1, pc, op);
-			m_code[pc] = (byte)Instruction::BAD;
+			code[pc] = (byte)Instruction::BAD;
 		}
 
 		if (op == Instruction::JUMPDEST)
 		{
-			m_jumpDests.push_back(pc);
+			analysis->jumpDests.push_back(pc);
 		}
 		else if (
 			(byte)Instruction::PUSH1 <= (byte)op &&
@@ -109,11 +107,11 @@ void VM::optimize()
 		else if (op == Instruction::JUMPV || op == Instruction::JUMPSUBV)
 		{
 			++pc;
-			pc += 4 * m_code[pc];  // number of 4-byte dests followed by table
+			pc += 4 * code[pc];  // number of 4-byte dests followed by table
 		}
 		else if (op == Instruction::BEGINSUB)
 		{
-			m_beginSubs.push_back(pc);
+			analysis->beginSubs.push_back(pc);
 		}
 		else if (op == Instruction::BEGINDATA)
 		{
@@ -122,9 +120,9 @@ void VM::optimize()
 #endif
 	}
 	
-#ifdef EVM_DO_FIRST_PASS_OPTIMIZATION
+#if EVM_DO_FIRST_PASS_OPTIMIZATION
 	
-	#ifdef EVM_USE_CONSTANT_POOL
+	#if EVM_USE_CONSTANT_POOL
 	
 		// maintain constant pool as a hash table of up to 256 u256 constants
 		struct hash256
@@ -165,7 +163,7 @@ void VM::optimize()
 				}
 				return table[hash] == val;
 			}
-		} constantPool(m_pool);
+		} constantPool(analysis->pool);
 		#define CONST_POOL_HASH_INIT() constantPool.hashInit()
 		#define CONST_POOL_HASH_BYTE(b) constantPool.hashByte(b)
 		#define CONST_POOL_GET_HASH() constantPool.getHash()
@@ -181,7 +179,7 @@ void VM::optimize()
 	for (size_t pc = 0; pc < nBytes; ++pc)
 	{
 		u256 val = 0;
-		Instruction op = Instruction(m_code[pc]);
+		Instruction op = Instruction(code[pc]);
 
 		if ((byte)Instruction::PUSH1 <= (byte)op && (byte)op <= (byte)Instruction::PUSH32)
 		{
@@ -190,13 +188,14 @@ void VM::optimize()
 
 			// decode pushed bytes to integral value
 			CONST_POOL_HASH_INIT();
-			val = m_code[pc+1];
+			val = code[pc+1];
+			CONST_POOL_HASH_BYTE(code[pc+1]);
 			for (uint64_t i = pc+2, n = nPush; --n; ++i) {
-				val = (val << 8) | m_code[i];
-				CONST_POOL_HASH_BYTE(m_code[i]);
+				val = (val << 8) | code[i];
+				CONST_POOL_HASH_BYTE(code[i]);
 			}
 
-		#ifdef EVM_USE_CONSTANT_POOL
+		#if EVM_USE_CONSTANT_POOL
 			if (1 < nPush)
 			{
 				// try to put value in constant pool at hash index
@@ -205,29 +204,29 @@ void VM::optimize()
 				byte hash = CONST_POOL_GET_HASH();
 				if (CONST_POOL_INSERT_VAL(hash, val))
 				{
-					m_code[pc] = (byte)Instruction::PUSHC;
-					m_code[pc+1] = hash;
-					m_code[pc+2] = nPush - 1;
+					code[pc] = (byte)Instruction::PUSHC;
+					code[pc+1] = hash;
+					code[pc+2] = nPush - 1;
 					TRACE_VAL(1, "constant pooled", val);
 				}
 				TRACE_POST_OPT(1, pc, op);
 			}
 		#endif
 
-		#ifdef EVM_REPLACE_CONST_JUMP	
+		#if EVM_REPLACE_CONST_JUMP
 			// replace JUMP or JUMPI to constant location with JUMPC or JUMPCI
 			// verifyJumpDest is M = log(number of jump destinations)
 			// outer loop is N = number of bytes in code array
 			// so complexity is N log M, worst case is N log N
 			size_t i = pc + nPush + 1;
-			op = Instruction(m_code[i]);
+			op = Instruction(code[i]);
 			if (op == Instruction::JUMP)
 			{
 				TRACE_STR(1, "Replace const JUMPC")
 				TRACE_PRE_OPT(1, i, op);
 				
 				if (0 <= verifyJumpDest(val, false))
-					m_code[i] = byte(op = Instruction::JUMPC);
+					code[i] = byte(op = Instruction::JUMPC);
 				
 				TRACE_POST_OPT(1, i, op);
 			}
@@ -237,9 +236,9 @@ void VM::optimize()
 				TRACE_PRE_OPT(1, i, op);
 				
 				if (0 <= verifyJumpDest(val, false))
-					m_code[i] = byte(op = Instruction::JUMPCI);
+					code[i] = byte(op = Instruction::JUMPCI);
 				
-				TRACE_POST_OPT(1, ii, op);
+				TRACE_POST_OPT(1, i, op);
 			}
 		#endif
 
@@ -260,7 +259,18 @@ void VM::initEntry()
 	m_bounce = &VM::interpretCases; 	
 	interpretCases(); // first call initializes jump table
 	initMetrics();
-	optimize();
+
+	// The first pass only depends on the code, so reuse it for code run before
+	CodeCache& cache = CodeCache::instance();
+	m_analysis = m_ext->codeHash ? cache.get(m_ext->codeHash) : nullptr;
+	if (!m_analysis)
+	{
+		optimize();
+		if (m_ext->codeHash)
+			cache.store(m_ext->codeHash, m_analysis);
+	}
+	m_code = m_analysis->optimizedCode.data();
+	m_pool = m_analysis->pool;
 }
 
 
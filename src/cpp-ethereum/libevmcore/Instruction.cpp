@@ -321,7 +321,7 @@ static const std::map<Instruction,  InstructionInfo> c_instructionInfo =
 	// these are generated by the interpreter - should never be in user code
 	{ Instruction::PUSHC,        { "PUSHC",          2,     0 ,    1,   false,     Tier::VeryLow } },
 	{ Instruction::JUMPC,        { "JUMPC",          0,     1,     0,   true,      Tier::Mid } },
-	{ Instruction::JUMPCI,       { "JUMPCI",         0,     1,     0,   true,      Tier::High } },
+	{ Instruction::JUMPCI,       { "JUMPCI",         0,     2,     0,   true,      Tier::High } },
 	{ Instruction::STOP,         { "BAD",            0,     0,     0,   true,      Tier::Zero } },
 }; 
  
@@ -160,7 +160,7 @@ public:
     bool HaveKey(const CKeyID& address) const override;
     bool GetKey(const CKeyID& address, CKey& keyOut) const override;
     bool GetPubKey(const CKeyID& address, CPubKey& vchPubKeyOut) const override;
-//    std::set<CKeyID> GetKeys() const override;
+    std::set<CKeyID> GetKeys() const override;
     bool GetHDChain(CHDChain& hdChainRet) const;
 
     /**
@@ -25,6 +25,64 @@
 #include "Lyra2.h"
 #include "Sponge.h"
 
+#if defined(ENABLE_AVX2) && (defined(__x86_64__) || defined(__amd64__) || defined(__i386__))
+#define LYRA2_CAN_USE_AVX2
+#include <cpuid.h>
+#endif
+
+#ifdef WIN32
+#include <malloc.h>
+#endif
+
+//Sponge operations used by LYRA2_ctx; switched to the AVX2 versions by LYRA2AutoDetect()
+typedef void (*AbsorbFn)(uint64_t *state, const uint64_t *in);
+typedef void (*SqueezeRowFn)(uint64_t *state, uint64_t *row, uint64_t nCols);
+typedef void (*DuplexRow1Fn)(uint64_t *state, uint64_t *rowIn, uint64_t *rowOut, uint64_t nCols);
+typedef void (*DuplexRowFn)(uint64_t *state, uint64_t *rowIn, uint64_t *rowInOut, uint64_t *rowOut, uint64_t nCols);
+
+static AbsorbFn absorbBlockImpl = absorbBlock;
+static AbsorbFn absorbBlockBlake2SafeImpl = absorbBlockBlake2Safe;
+static SqueezeRowFn reducedSqueezeRow0Impl = reducedSqueezeRow0;
+static DuplexRow1Fn reducedDuplexRow1Impl = reducedDuplexRow1;
+static DuplexRowFn reducedDuplexRowSetupImpl = reducedDuplexRowSetup;
+static DuplexRowFn reducedDuplexRowImpl = reducedDuplexRow;
+
+static void *alignedAlloc(size_t size) {
+#ifdef WIN32
+	return _aligned_malloc(size, 32);
+#else
+	void *ptr = NULL;
+	if (posix_memalign(&ptr, 32, size) != 0)
+		return NULL;
+	return ptr;
+#endif
+}
+
+static void alignedFree(void *ptr) {
+#ifdef WIN32
+	_aligned_free(ptr);
+#else
+	free(ptr);
+#endif
+}
+
+void LYRA2_ctx_free(LYRA2_CTX *ctx) {
+	alignedFree(ctx->wholeMatrix);
+	free(ctx->memMatrix);
+	ctx->wholeMatrix = NULL;
+	ctx->memMatrix = NULL;
+	ctx->matrixBytes = 0;
+	ctx->nRowsAlloc = 0;
+}
+
+int LYRA2(void *K, int64_t kLen, const void *pwd, int32_t pwdlen, const void *salt, int32_t saltlen, int64_t timeCost, const int16_t nRows, const int16_t nCols)
+{
+	LYRA2_CTX ctx = { NULL, NULL, 0, 0 };
+	int result = LYRA2_ctx(&ctx, K, kLen, pwd, pwdlen, salt, saltlen, timeCost, nRows, nCols);
+	LYRA2_ctx_free(&ctx);
+	return result;
+}
+
 /**
  * Executes Lyra2 based on the G function from Blake2b. This version supports salts and passwords
  * whose combined length is smaller than the size of the memory matrix, (i.e., (nRows x nCols x b) bits,
@@ -42,9 +100,13 @@
  * @param nRows Number or rows of the memory matrix (R)
  * @param nCols Number of columns of the memory matrix (C)
  *
+ * The memory matrix is taken from ctx and only (re)allocated when it is too small.
+ *
+ * @param ctx Reusable memory matrix
+ * @param K The derived key to be output by the algorithm
  * @return 0 if the key is generated correctly; -1 if there is an error (usually due to lack of memory for allocation)
  */
-int LYRA2(void *K, int64_t kLen, const void *pwd, int32_t pwdlen, const void *salt, int32_t saltlen, int64_t timeCost, const int16_t nRows, const int16_t nCols)
+int LYRA2_ctx(LYRA2_CTX *ctx, void *K, int64_t kLen, const void *pwd, int32_t pwdlen, const void *salt, int32_t saltlen, int64_t timeCost, const int16_t nRows, const int16_t nCols)
 {
 	//============================= Basic variables ============================//
 	int64_t row = 2; //index of row to be processed
@@ -67,14 +129,24 @@ int LYRA2(void *K, int64_t kLen, const void *pwd, int32_t pwdlen, const void *sa
 	const int64_t BLOCK_LEN = (nCols == 4) ? BLOCK_LEN_BLAKE2_SAFE_INT64 : BLOCK_LEN_BLAKE2_SAFE_BYTES;
 
 	i = (int64_t)ROW_LEN_BYTES * nRows;
-	uint64_t *wholeMatrix = malloc(i);
+	if (ctx->matrixBytes < i) {
+		alignedFree(ctx->wholeMatrix);
+		ctx->wholeMatrix = alignedAlloc(i);
+		ctx->matrixBytes = ctx->wholeMatrix ? i : 0;
+	}
+	uint64_t *wholeMatrix = ctx->wholeMatrix;
 	if (wholeMatrix == NULL) {
 		return -1;
 	}
 	memset(wholeMatrix, 0, i);
 
 	//Allocates pointers to each row of the matrix
-	uint64_t **memMatrix = malloc(sizeof(uint64_t*) * nRows);
+	if (ctx->nRowsAlloc < nRows) {
+		free(ctx->memMatrix);
+		ctx->memMatrix = malloc(sizeof(uint64_t*) * nRows);
+		ctx->nRowsAlloc = ctx->memMatrix ? nRows : 0;
+	}
+	uint64_t **memMatrix = ctx->memMatrix;
 	if (memMatrix == NULL) {
 		return -1;
 	}
@@ -141,19 +213,19 @@ int LYRA2(void *K, int64_t kLen, const void *pwd, int32_t pwdlen, const void *sa
 	//Absorbing salt, password and basil: this is the only place in which the block length is hard-coded to 512 bits
 	ptrWord = wholeMatrix;
 	for (i = 0; i < nBlocksInput; i++) {
-		absorbBlockBlake2Safe(state, ptrWord); //absorbs each block of pad(pwd || salt || basil)
+		absorbBlockBlake2SafeImpl(state, ptrWord); //absorbs each block of pad(pwd || salt || basil)
 		ptrWord += BLOCK_LEN; //goes to next block of pad(pwd || salt || basil)
 	}
 
 	//Initializes M[0] and M[1]
-	reducedSqueezeRow0(state, memMatrix[0], nCols); //The locally copied password is most likely overwritten here
+	reducedSqueezeRow0Impl(state, memMatrix[0], nCols); //The locally copied password is most likely overwritten here
 
-	reducedDuplexRow1(state, memMatrix[0], memMatrix[1], nCols);
+	reducedDuplexRow1Impl(state, memMatrix[0], memMatrix[1], nCols);
 
 	do {
 		//M[row] = rand; //M[row*] = M[row*] XOR rotW(rand)
 
-		reducedDuplexRowSetup(state, memMatrix[prev], memMatrix[rowa], memMatrix[row], nCols);
+		reducedDuplexRowSetupImpl(state, memMatrix[prev], memMatrix[rowa], memMatrix[row], nCols);
 
 		//updates the value of row* (deterministically picked during Setup))
 		rowa = (rowa + step) & (window - 1);
@@ -185,7 +257,7 @@ int LYRA2(void *K, int64_t kLen, const void *pwd, int32_t pwdlen, const void *sa
 			//------------------------------------------------------------------------------------------
 
 			//Performs a reduced-round duplexing operation over M[row*] XOR M[prev], updating both M[row*] and M[row]
-			reducedDuplexRow(state, memMatrix[prev], memMatrix[rowa], memMatrix[row], nCols);
+			reducedDuplexRowImpl(state, memMatrix[prev], memMatrix[rowa], memMatrix[row], nCols);
 
 			//update prev: it now points to the last row ever computed
 			prev = row;
@@ -201,14 +273,67 @@ int LYRA2(void *K, int64_t kLen, const void *pwd, int32_t pwdlen, const void *sa
 
 	//============================ Wrap-up Phase ===============================//
 	//Absorbs the last block of the memory matrix
-	absorbBlock(state, memMatrix[rowa]);
+	absorbBlockImpl(state, memMatrix[rowa]);
 
 	//Squeezes the key
 	squeeze(state, K, (unsigned int) kLen);
 
-	//========================= Freeing the memory =============================//
-	free(memMatrix);
-	free(wholeMatrix);
-
 	return 0;
 }
+
+#ifdef LYRA2_CAN_USE_AVX2
+static int HaveAVX2(void) {
+	unsigned int a, b, c, d;
+	if (!__get_cpuid(1, &a, &b, &c, &d))
+		return 0;
+	//The CPU must support AVX and the OS must save the YMM registers (OSXSAVE + XCR0)
+	if (!((c >> 27) & 1) || !((c >> 28) & 1))
+		return 0;
+	unsigned int xcr0, xcr0_hi;
+	__asm__ ("xgetbv" : "=a"(xcr0), "=d"(xcr0_hi) : "c"(0));
+	if ((xcr0 & 6) != 6)
+		return 0;
+	if (__get_cpuid_max(0, NULL) < 7)
+		return 0;
+	__cpuid_count(7, 0, a, b, c, d);
+	return (b >> 5) & 1;
+}
+#endif
+
+//Hashes a fixed PHI2-sized input with the selected implementation
+static void SelfTestHash(unsigned char out[64]) {
+	unsigned char in[64];
+	int i;
+	for (i = 0; i < 64; i++)
+		in[i] = (unsigned char)(i * 7 + 1);
+	LYRA2(out, 32, in, 32, in, 32, 1, 8, 8);
+	LYRA2(out + 32, 32, in + 32, 32, in + 32, 32, 1, 4, 4);
+}
+
+const char *LYRA2AutoDetect(void) {
+#ifdef LYRA2_CAN_USE_AVX2
+	if (HaveAVX2()) {
+		unsigned char expected[64], result[64];
+		SelfTestHash(expected);
+
+		absorbBlockImpl = absorbBlock_avx2;
+		absorbBlockBlake2SafeImpl = absorbBlockBlake2Safe_avx2;
+		reducedSqueezeRow0Impl = reducedSqueezeRow0_avx2;
+		reducedDuplexRow1Impl = reducedDuplexRow1_avx2;
+		reducedDuplexRowSetupImpl = reducedDuplexRowSetup_avx2;
+		reducedDuplexRowImpl = reducedDuplexRow_avx2;
+
+		SelfTestHash(result);
+		if (memcmp(expected, result, sizeof(result)) == 0)
+			return "avx2";
+
+		absorbBlockImpl = absorbBlock;
+		absorbBlockBlake2SafeImpl = absorbBlockBlake2Safe;
+		reducedSqueezeRow0Impl = reducedSqueezeRow0;
+		reducedDuplexRow1Impl = reducedDuplexRow1;
+		reducedDuplexRowSetupImpl = reducedDuplexRowSetup;
+		reducedDuplexRowImpl = reducedDuplexRow;
+	}
+#endif
+	return "standard";
+}
@@ -41,7 +41,23 @@ typedef unsigned char byte;
 extern "C" {
 #endif
 
+/**
+ * Reusable memory matrix for LYRA2_ctx, so repeated hashes neither allocate nor free.
+ * Zero-initialize before first use and release with LYRA2_ctx_free.
+ */
+typedef struct {
+    uint64_t *wholeMatrix; //32-byte aligned matrix storage
+    uint64_t **memMatrix;  //pointers to each row
+    int64_t matrixBytes;   //allocated size of wholeMatrix
+    int64_t nRowsAlloc;    //allocated size of memMatrix
+} LYRA2_CTX;
+
 int LYRA2(void *K, int64_t kLen, const void *pwd, int32_t pwdlen, const void *salt, int32_t saltlen, int64_t timeCost, const int16_t nRows, const int16_t nCols);
+int LYRA2_ctx(LYRA2_CTX *ctx, void *K, int64_t kLen, const void *pwd, int32_t pwdlen, const void *salt, int32_t saltlen, int64_t timeCost, const int16_t nRows, const int16_t nCols);
+void LYRA2_ctx_free(LYRA2_CTX *ctx);
+
+/** Select the fastest sponge implementation supported by this CPU; returns its name */
+const char *LYRA2AutoDetect(void);
 
 #ifdef __cplusplus
 }
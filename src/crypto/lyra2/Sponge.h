@@ -92,6 +92,16 @@ void reducedDuplexRow(uint64_t *state, uint64_t *rowIn, uint64_t *rowInOut, uint
 //---- Misc
 void printArray(unsigned char *array, unsigned int size, char *name);
 
+//---- AVX2 versions of the absorbs and row duplexes (Sponge_avx2.c), selected at runtime
+#if defined(ENABLE_AVX2)
+void absorbBlock_avx2(uint64_t *state, const uint64_t *in);
+void absorbBlockBlake2Safe_avx2(uint64_t *state, const uint64_t *in);
+void reducedSqueezeRow0_avx2(uint64_t* state, uint64_t* row, uint64_t nCols);
+void reducedDuplexRow1_avx2(uint64_t *state, uint64_t *rowIn, uint64_t *rowOut, uint64_t nCols);
+void reducedDuplexRowSetup_avx2(uint64_t *state, uint64_t *rowIn, uint64_t *rowInOut, uint64_t *rowOut, uint64_t nCols);
+void reducedDuplexRow_avx2(uint64_t *state, uint64_t *rowIn, uint64_t *rowInOut, uint64_t *rowOut, uint64_t nCols);
+#endif
+
 ////////////////////////////////////////////////////////////////////////////////////////////////
 
 
@@ -0,0 +1,219 @@
+/**
+ * AVX2 implementation of the Lyra2 sponge operations that dominate the cost of
+ * LYRA2: the absorbs and the reduced-round row squeeze/duplexes. The 16-word
+ * Blake2b state is kept in four 256-bit registers for the whole row, one per
+ * row of the Blake2b 4x4 matrix, and the diagonal step is done with lane
+ * permutations. Results are bit-identical to Sponge.c.
+ *
+ * This file is compiled with -mavx2 and must only be called after
+ * LYRA2AutoDetect() has confirmed that the CPU and OS support AVX2.
+ *
+ * This software is hereby placed in the public domain.
+ */
+#include "Sponge.h"
+#include "Lyra2.h"
+
+#if defined(ENABLE_AVX2) && defined(__AVX2__)
+
+#include <immintrin.h>
+
+#define LOAD(p) _mm256_loadu_si256((const __m256i*)(p))
+#define STORE(p, r) _mm256_storeu_si256((__m256i*)(p), r)
+
+#define ROTR32(x) _mm256_shuffle_epi32(x, _MM_SHUFFLE(2, 3, 0, 1))
+#define ROTR24(x) _mm256_shuffle_epi8(x, r24)
+#define ROTR16(x) _mm256_shuffle_epi8(x, r16)
+#define ROTR63(x) _mm256_or_si256(_mm256_srli_epi64(x, 63), _mm256_add_epi64(x, x))
+
+/*Blake2b's G function on four columns at once*/
+#define G_AVX2(a, b, c, d) \
+  do { \
+    a = _mm256_add_epi64(a, b); \
+    d = ROTR32(_mm256_xor_si256(d, a)); \
+    c = _mm256_add_epi64(c, d); \
+    b = ROTR24(_mm256_xor_si256(b, c)); \
+    a = _mm256_add_epi64(a, b); \
+    d = ROTR16(_mm256_xor_si256(d, a)); \
+    c = _mm256_add_epi64(c, d); \
+    b = ROTR63(_mm256_xor_si256(b, c)); \
+  } while(0)
+
+/*One round of Blake2b's compression function: columns, then diagonals*/
+#define ROUND_LYRA_AVX2(a, b, c, d) \
+  do { \
+    G_AVX2(a, b, c, d); \
+    b = _mm256_permute4x64_epi64(b, _MM_SHUFFLE(0, 3, 2, 1)); \
+    c = _mm256_permute4x64_epi64(c, _MM_SHUFFLE(1, 0, 3, 2)); \
+    d = _mm256_permute4x64_epi64(d, _MM_SHUFFLE(2, 1, 0, 3)); \
+    G_AVX2(a, b, c, d); \
+    b = _mm256_permute4x64_epi64(b, _MM_SHUFFLE(2, 1, 0, 3)); \
+    c = _mm256_permute4x64_epi64(c, _MM_SHUFFLE(1, 0, 3, 2)); \
+    d = _mm256_permute4x64_epi64(d, _MM_SHUFFLE(0, 3, 2, 1)); \
+  } while(0)
+
+#define ROTATION_MASKS \
+    const __m256i r24 = _mm256_setr_epi8(3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10, \
+                                         3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10); \
+    const __m256i r16 = _mm256_setr_epi8(2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9, \
+                                         2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9)
+
+/*rotW(rand): the first 12 state words rotated by one word, {s11, s0, ..., s10}*/
+#define ROTW(a, b, c, o0, o1, o2) \
+  do { \
+    __m256i ra = _mm256_permute4x64_epi64(a, _MM_SHUFFLE(2, 1, 0, 3)); \
+    __m256i rb = _mm256_permute4x64_epi64(b, _MM_SHUFFLE(2, 1, 0, 3)); \
+    __m256i rc = _mm256_permute4x64_epi64(c, _MM_SHUFFLE(2, 1, 0, 3)); \
+    o0 = _mm256_blend_epi32(ra, rc, 0x03); \
+    o1 = _mm256_blend_epi32(rb, ra, 0x03); \
+    o2 = _mm256_blend_epi32(rc, rb, 0x03); \
+  } while(0)
+
+static inline void blake2bLyra_avx2(__m256i *a, __m256i *b, __m256i *c, __m256i *d) {
+    ROTATION_MASKS;
+    __m256i va = *a, vb = *b, vc = *c, vd = *d;
+    int i;
+    for (i = 0; i < 12; i++)
+        ROUND_LYRA_AVX2(va, vb, vc, vd);
+    *a = va; *b = vb; *c = vc; *d = vd;
+}
+
+void absorbBlock_avx2(uint64_t *state, const uint64_t *in) {
+    __m256i a = _mm256_xor_si256(LOAD(state), LOAD(in));
+    __m256i b = _mm256_xor_si256(LOAD(state + 4), LOAD(in + 4));
+    __m256i c = _mm256_xor_si256(LOAD(state + 8), LOAD(in + 8));
+    __m256i d = LOAD(state + 12);
+    blake2bLyra_avx2(&a, &b, &c, &d);
+    STORE(state, a); STORE(state + 4, b); STORE(state + 8, c); STORE(state + 12, d);
+}
+
+void absorbBlockBlake2Safe_avx2(uint64_t *state, const uint64_t *in) {
+    __m256i a = _mm256_xor_si256(LOAD(state), LOAD(in));
+    __m256i b = _mm256_xor_si256(LOAD(state + 4), LOAD(in + 4));
+    __m256i c = LOAD(state + 8);
+    __m256i d = LOAD(state + 12);
+    blake2bLyra_avx2(&a, &b, &c, &d);
+    STORE(state, a); STORE(state + 4, b); STORE(state + 8, c); STORE(state + 12, d);
+}
+
+void reducedSqueezeRow0_avx2(uint64_t* state, uint64_t* rowOut, uint64_t nCols) {
+    ROTATION_MASKS;
+    uint64_t* ptrWord = rowOut + (nCols-1)*BLOCK_LEN_INT64; //In Lyra2: pointer to M[0][C-1]
+    __m256i a = LOAD(state), b = LOAD(state + 4), c = LOAD(state + 8), d = LOAD(state + 12);
+    uint64_t i;
+
+    for (i = 0; i < nCols; i++) {
+        //M[row][C-1-col] = H.reduced_squeeze()
+        STORE(ptrWord, a);
+        STORE(ptrWord + 4, b);
+        STORE(ptrWord + 8, c);
+        ptrWord -= BLOCK_LEN_INT64;
+
+        ROUND_LYRA_AVX2(a, b, c, d);
+    }
+    STORE(state, a); STORE(state + 4, b); STORE(state + 8, c); STORE(state + 12, d);
+}
+
+void reducedDuplexRow1_avx2(uint64_t *state, uint64_t *rowIn, uint64_t *rowOut, uint64_t nCols) {
+    ROTATION_MASKS;
+    uint64_t* ptrWordIn = rowIn;                               //In Lyra2: pointer to prev
+    uint64_t* ptrWordOut = rowOut + (nCols-1)*BLOCK_LEN_INT64; //In Lyra2: pointer to row
+    __m256i a = LOAD(state), b = LOAD(state + 4), c = LOAD(state + 8), d = LOAD(state + 12);
+    uint64_t i;
+
+    for (i = 0; i < nCols; i++) {
+        __m256i in0 = LOAD(ptrWordIn), in1 = LOAD(ptrWordIn + 4), in2 = LOAD(ptrWordIn + 8);
+
+        //Absorbing "M[prev][col]"
+        a = _mm256_xor_si256(a, in0);
+        b = _mm256_xor_si256(b, in1);
+        c = _mm256_xor_si256(c, in2);
+
+        ROUND_LYRA_AVX2(a, b, c, d);
+
+        //M[row][C-1-col] = M[prev][col] XOR rand
+        STORE(ptrWordOut, _mm256_xor_si256(in0, a));
+        STORE(ptrWordOut + 4, _mm256_xor_si256(in1, b));
+        STORE(ptrWordOut + 8, _mm256_xor_si256(in2, c));
+
+        ptrWordIn += BLOCK_LEN_INT64;
+        ptrWordOut -= BLOCK_LEN_INT64;
+    }
+    STORE(state, a); STORE(state + 4, b); STORE(state + 8, c); STORE(state + 12, d);
+}
+
+void reducedDuplexRowSetup_avx2(uint64_t *state, uint64_t *rowIn, uint64_t *rowInOut, uint64_t *rowOut, uint64_t nCols) {
+    ROTATION_MASKS;
+    uint64_t* ptrWordIn = rowIn;                               //In Lyra2: pointer to prev
+    uint64_t* ptrWordInOut = rowInOut;                         //In Lyra2: pointer to row*
+    uint64_t* ptrWordOut = rowOut + (nCols-1)*BLOCK_LEN_INT64; //In Lyra2: pointer to row
+    __m256i a = LOAD(state), b = LOAD(state + 4), c = LOAD(state + 8), d = LOAD(state + 12);
+    uint64_t i;
+
+    for (i = 0; i < nCols; i++) {
+        __m256i in0 = LOAD(ptrWordIn), in1 = LOAD(ptrWordIn + 4), in2 = LOAD(ptrWordIn + 8);
+        __m256i io0 = LOAD(ptrWordInOut), io1 = LOAD(ptrWordInOut + 4), io2 = LOAD(ptrWordInOut + 8);
+        __m256i t0, t1, t2;
+
+        //Absorbing "M[prev] [+] M[row*]"
+        a = _mm256_xor_si256(a, _mm256_add_epi64(in0, io0));
+        b = _mm256_xor_si256(b, _mm256_add_epi64(in1, io1));
+        c = _mm256_xor_si256(c, _mm256_add_epi64(in2, io2));
+
+        ROUND_LYRA_AVX2(a, b, c, d);
+
+        //M[row][col] = M[prev][col] XOR rand
+        STORE(ptrWordOut, _mm256_xor_si256(in0, a));
+        STORE(ptrWordOut + 4, _mm256_xor_si256(in1, b));
+        STORE(ptrWordOut + 8, _mm256_xor_si256(in2, c));
+
+        //M[row*][col] = M[row*][col] XOR rotW(rand)
+        ROTW(a, b, c, t0, t1, t2);
+        STORE(ptrWordInOut, _mm256_xor_si256(io0, t0));
+        STORE(ptrWordInOut + 4, _mm256_xor_si256(io1, t1));
+        STORE(ptrWordInOut + 8, _mm256_xor_si256(io2, t2));
+
+        ptrWordInOut += BLOCK_LEN_INT64;
+        ptrWordIn += BLOCK_LEN_INT64;
+        ptrWordOut -= BLOCK_LEN_INT64;
+    }
+    STORE(state, a); STORE(state + 4, b); STORE(state + 8, c); STORE(state + 12, d);
+}
+
+void reducedDuplexRow_avx2(uint64_t *state, uint64_t *rowIn, uint64_t *rowInOut, uint64_t *rowOut, uint64_t nCols) {
+    ROTATION_MASKS;
+    uint64_t* ptrWordInOut = rowInOut; //In Lyra2: pointer to row*
+    uint64_t* ptrWordIn = rowIn;       //In Lyra2: pointer to prev
+    uint64_t* ptrWordOut = rowOut;     //In Lyra2: pointer to row
+    __m256i a = LOAD(state), b = LOAD(state + 4), c = LOAD(state + 8), d = LOAD(state + 12);
+    uint64_t i;
+
+    for (i = 0; i < nCols; i++) {
+        __m256i t0, t1, t2;
+
+        //Absorbing "M[prev] [+] M[row*]"
+        a = _mm256_xor_si256(a, _mm256_add_epi64(LOAD(ptrWordIn), LOAD(ptrWordInOut)));
+        b = _mm256_xor_si256(b, _mm256_add_epi64(LOAD(ptrWordIn + 4), LOAD(ptrWordInOut + 4)));
+        c = _mm256_xor_si256(c, _mm256_add_epi64(LOAD(ptrWordIn + 8), LOAD(ptrWordInOut + 8)));
+
+        ROUND_LYRA_AVX2(a, b, c, d);
+
+        //M[rowOut][col] = M[rowOut][col] XOR rand
+        STORE(ptrWordOut, _mm256_xor_si256(LOAD(ptrWordOut), a));
+        STORE(ptrWordOut + 4, _mm256_xor_si256(LOAD(ptrWordOut + 4), b));
+        STORE(ptrWordOut + 8, _mm256_xor_si256(LOAD(ptrWordOut + 8), c));
+
+        //M[rowInOut][col] = M[rowInOut][col] XOR rotW(rand)
+        //(rowInOut may be the same row as rowOut, so it is reloaded after the store above)
+        ROTW(a, b, c, t0, t1, t2);
+        STORE(ptrWordInOut, _mm256_xor_si256(LOAD(ptrWordInOut), t0));
+        STORE(ptrWordInOut + 4, _mm256_xor_si256(LOAD(ptrWordInOut + 4), t1));
+        STORE(ptrWordInOut + 8, _mm256_xor_si256(LOAD(ptrWordInOut + 8), t2));
+
+        ptrWordOut += BLOCK_LEN_INT64;
+        ptrWordInOut += BLOCK_LEN_INT64;
+        ptrWordIn += BLOCK_LEN_INT64;
+    }
+    STORE(state, a); STORE(state + 4, b); STORE(state + 8, c); STORE(state + 12, d);
+}
+
+#endif
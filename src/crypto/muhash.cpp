@@ -0,0 +1,179 @@
+// Copyright (c) 2017 The Bitcoin developers
+// Copyright (c) 2015-2018 The Luxcore developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "crypto/muhash.h"
+
+#include "crypto/common.h"
+#include "crypto/sha256.h"
+
+#include <string.h>
+
+namespace
+{
+/** 2^3072 - MAX_PRIME_DIFF is the largest 3072-bit prime */
+const uint32_t MAX_PRIME_DIFF = 1103717;
+
+/** Map a byte string to a group element: SHA256 of it, stretched with SHA256 in counter mode */
+Num3072 ToNum3072(const unsigned char* data, size_t len)
+{
+    unsigned char hash[CSHA256::OUTPUT_SIZE];
+    CSHA256().Write(data, len).Finalize(hash);
+
+    unsigned char bytes[Num3072::BYTE_SIZE];
+    for (unsigned char i = 0; i < Num3072::BYTE_SIZE / CSHA256::OUTPUT_SIZE; i++)
+        CSHA256().Write(hash, sizeof(hash)).Write(&i, 1).Finalize(bytes + i * CSHA256::OUTPUT_SIZE);
+    return Num3072(bytes);
+}
+} // namespace
+
+Num3072::Num3072()
+{
+    limbs[0] = 1;
+    for (int i = 1; i < LIMBS; i++)
+        limbs[i] = 0;
+}
+
+Num3072::Num3072(const unsigned char data[BYTE_SIZE])
+{
+    for (int i = 0; i < LIMBS; i++)
+        limbs[i] = ReadLE32(data + 4 * i);
+    if (IsOverflow())
+        FullReduce();
+}
+
+bool Num3072::IsOverflow() const
+{
+    // The modulus is all one bits except for the lowest limb
+    if (limbs[0] <= 0xFFFFFFFF - MAX_PRIME_DIFF)
+        return false;
+    for (int i = 1; i < LIMBS; i++) {
+        if (limbs[i] != 0xFFFFFFFF)
+            return false;
+    }
+    return true;
+}
+
+void Num3072::FullReduce()
+{
+    // x - p = x + MAX_PRIME_DIFF - 2^3072
+    uint64_t acc = MAX_PRIME_DIFF;
+    for (int i = 0; i < LIMBS; i++) {
+        acc += limbs[i];
+        limbs[i] = (uint32_t)acc;
+        acc >>= 32;
+    }
+}
+
+void Num3072::Multiply(const Num3072& a)
+{
+    // Schoolbook product into 2 * LIMBS limbs. Reads both inputs before
+    // writing, so squaring in place (a == *this) is fine.
+    uint32_t tmp[2 * LIMBS];
+    memset(tmp, 0, sizeof(tmp));
+    for (int i = 0; i < LIMBS; i++) {
+        uint64_t carry = 0;
+        for (int j = 0; j < LIMBS; j++) {
+            uint64_t t = (uint64_t)limbs[i] * a.limbs[j] + tmp[i + j] + carry;
+            tmp[i + j] = (uint32_t)t;
+            carry = t >> 32;
+        }
+        tmp[i + LIMBS] = (uint32_t)carry;
+    }
+
+    // 2^3072 = MAX_PRIME_DIFF (mod p): fold the upper half onto the lower one
+    uint64_t carry = 0;
+    for (int i = 0; i < LIMBS; i++) {
+        uint64_t t = (uint64_t)tmp[LIMBS + i] * MAX_PRIME_DIFF + tmp[i] + carry;
+        limbs[i] = (uint32_t)t;
+        carry = t >> 32;
+    }
+    while (carry) {
+        uint64_t acc = carry * MAX_PRIME_DIFF;
+        carry = 0;
+        for (int i = 0; i < LIMBS; i++) {
+            acc += limbs[i];
+            limbs[i] = (uint32_t)acc;
+            acc >>= 32;
+            if (!acc)
+                break;
+        }
+        carry = acc;
+    }
+    if (IsOverflow())
+        FullReduce();
+}
+
+Num3072 Num3072::GetInverse() const
+{
+    // Fermat's little theorem: a^(p - 2), square-and-multiply over the bits of p - 2
+    Num3072 result;
+    for (int i = LIMBS - 1; i >= 0; i--) {
+        uint32_t exponent = i == 0 ? (uint32_t)(0 - MAX_PRIME_DIFF - 2) : 0xFFFFFFFF;
+        for (int bit = 31; bit >= 0; bit--) {
+            result.Multiply(result);
+            if ((exponent >> bit) & 1)
+                result.Multiply(*this);
+        }
+    }
+    return result;
+}
+
+void Num3072::ToBytes(unsigned char out[BYTE_SIZE]) const
+{
+    for (int i = 0; i < LIMBS; i++)
+        WriteLE32(out + 4 * i, limbs[i]);
+}
+
+MuHash3072::MuHash3072()
+{
+}
+
+MuHash3072& MuHash3072::Insert(const unsigned char* data, size_t len)
+{
+    numerator.Multiply(ToNum3072(data, len));
+    return *this;
+}
+
+MuHash3072& MuHash3072::Remove(const unsigned char* data, size_t len)
+{
+    denominator.Multiply(ToNum3072(data, len));
+    return *this;
+}
+
+MuHash3072& MuHash3072::operator*=(const MuHash3072& mul)
+{
+    numerator.Multiply(mul.numerator);
+    denominator.Multiply(mul.denominator);
+    return *this;
+}
+
+MuHash3072& MuHash3072::operator/=(const MuHash3072& div)
+{
+    numerator.Multiply(div.denominator);
+    denominator.Multiply(div.numerator);
+    return *this;
+}
+
+void MuHash3072::Finalize(unsigned char hash[OUTPUT_SIZE]) const
+{
+    Num3072 value = numerator;
+    value.Multiply(denominator.GetInverse());
+
+    unsigned char bytes[Num3072::BYTE_SIZE];
+    value.ToBytes(bytes);
+    CSHA256().Write(bytes, sizeof(bytes)).Finalize(hash);
+}
+
+void MuHash3072::GetState(unsigned char state[STATE_SIZE]) const
+{
+    numerator.ToBytes(state);
+    denominator.ToBytes(state + Num3072::BYTE_SIZE);
+}
+
+void MuHash3072::SetState(const unsigned char state[STATE_SIZE])
+{
+    numerator = Num3072(state);
+    denominator = Num3072(state + Num3072::BYTE_SIZE);
+}
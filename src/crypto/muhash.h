@@ -0,0 +1,70 @@
+// Copyright (c) 2017 The Bitcoin developers
+// Copyright (c) 2015-2018 The Luxcore developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_CRYPTO_MUHASH_H
+#define BITCOIN_CRYPTO_MUHASH_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/** An element of the multiplicative group of integers modulo 2^3072 - 1103717 */
+class Num3072
+{
+public:
+    static const int LIMBS = 96;
+    static const size_t BYTE_SIZE = 384;
+
+    uint32_t limbs[LIMBS];
+
+    Num3072();
+    explicit Num3072(const unsigned char data[BYTE_SIZE]);
+
+    void Multiply(const Num3072& a);
+    Num3072 GetInverse() const;
+    void ToBytes(unsigned char out[BYTE_SIZE]) const;
+
+private:
+    bool IsOverflow() const;
+    void FullReduce();
+};
+
+/**
+ * A rolling hash of a set of byte strings (MuHash3072).
+ *
+ * Every element is hashed to a number modulo a 3072-bit prime and the set hash
+ * is the product of them, kept as a numerator and a denominator so that
+ * elements can be removed again without an inversion. Adding and removing
+ * commute, so the result only depends on the final contents of the set.
+ * Elements are mapped with SHA256 in counter mode.
+ */
+class MuHash3072
+{
+private:
+    Num3072 numerator;
+    Num3072 denominator;
+
+public:
+    static const size_t OUTPUT_SIZE = 32;
+    static const size_t STATE_SIZE = 2 * Num3072::BYTE_SIZE;
+
+    /** The hash of the empty set */
+    MuHash3072();
+
+    MuHash3072& Insert(const unsigned char* data, size_t len);
+    MuHash3072& Remove(const unsigned char* data, size_t len);
+
+    /** Combine with the hash of another set (union) / take it out again */
+    MuHash3072& operator*=(const MuHash3072& mul);
+    MuHash3072& operator/=(const MuHash3072& div);
+
+    /** SHA256 of the 3072-bit set value. Needs one modular inversion. */
+    void Finalize(unsigned char hash[OUTPUT_SIZE]) const;
+
+    /** Raw numerator and denominator, for storing a running hash */
+    void GetState(unsigned char state[STATE_SIZE]) const;
+    void SetState(const unsigned char state[STATE_SIZE]);
+};
+
+#endif // BITCOIN_CRYPTO_MUHASH_H
@@ -4,137 +4,416 @@
 #include "rx2.h"
 #include "RandomX/randomx.h"
 
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include <boost/thread/tss.hpp>
 
-//    bool is_init = false;
-//   static char randomx_seed[64]; //={0}; // this should be 64 and not 32
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <vector>
 
-//    randomx_flags flags;
-//    randomx_vm* rx_vm = nullptr;
-//    randomx_cache* cache = nullptr;
-
-//#define KEY_CHANGE 2048
-//#define SWITCH_KEY 64
 static CCriticalSection cs_randomx;
 
-uint256 GetRandomXSeed(const uint32_t& nHeight)
-{  
-    static uint256 current_key_block;
+/**
+ * Height of the block whose hash keys RandomX for nHeight, or -1 for the
+ * genesis block.
+ */
+static int GetRandomXSeedHeight(uint32_t nHeight)
+{
     uint32_t SeedStartingHeight = Params().GetConsensus().RX2SeedHeight;
     uint32_t SeedInterval = Params().GetConsensus().RX2SeedInterval;
     uint32_t SwitchKey = SeedStartingHeight % SeedInterval;
 
-    if (current_key_block == uint256())
-        current_key_block = chainActive.Genesis()->GetBlockHash();
-
     uint32_t remainer = nHeight % SeedInterval;
 
     uint32_t first_check = nHeight - remainer;
     uint32_t second_check = nHeight - SeedInterval - remainer;
 
     if (nHeight > nHeight - remainer + SwitchKey) {
-        
-        if ( nHeight  > first_check)
-            current_key_block = /*uint256("0xaf8367c7285833f5036ae884aadcc64a277b7e20bfb160cf57eaf7ece0e00c68size"); */ chainActive[first_check-SeedStartingHeight]->GetBlockHash();
+        if (nHeight > first_check)
+            return first_check - SeedStartingHeight;
     } else {
-           
-        if ( nHeight  > second_check) {
-            
-            current_key_block = /*uint256("0xaf8367c7285833f5036ae884aadcc64a277b7e20bfb160cf57eaf7ece0e00c68size"); */ chainActive[second_check-SeedStartingHeight]->GetBlockHash();
-        }
+        if (nHeight > second_check)
+            return second_check - SeedStartingHeight;
     }
-    return current_key_block;
+    return -1;
 }
 
+uint256 GetRandomXSeed(const uint32_t& nHeight)
+{  
+    // Hashing may run on several threads at once, so the key block is
+    // computed from scratch on every call instead of cached in a static.
+    int nSeedHeight = GetRandomXSeedHeight(nHeight);
+    if (nSeedHeight < 0)
+        return chainActive.Genesis()->GetBlockHash();
+    return chainActive[nSeedHeight]->GetBlockHash();
+}
 
-void rx_slow_hash(const char* data, char* hash, int length, uint256 seedhash)
+bool GetRandomXSeed(const uint32_t& nHeight, uint256& seed)
 {
-    ENTER_CRITICAL_SECTION(cs_randomx) 
-
-    static bool is_init; // = false;
-//    static char randomx_seed[64]; //={0}; // this should be 64 and not 32
-    static uint256 randomx_seed2;
-    static randomx_flags flags;
-    static randomx_vm *rx_vm; // = nullptr;
-    static randomx_cache *cache; // = nullptr;
+    int nSeedHeight = GetRandomXSeedHeight(nHeight);
+    const CBlockIndex* pindexSeed = nSeedHeight < 0 ? chainActive.Genesis() : chainActive[nSeedHeight];
+    if (!pindexSeed)
+        return false;
+    seed = pindexSeed->GetBlockHash();
+    return true;
+}
 
- 
-    if (!is_init) {
+/** Full RandomX dataset built from one seed epoch's cache. */
+class CRandomXDataset
+{
+public:
+    randomx_dataset* dataset;
 
-        randomx_seed2 = seedhash;
-    if (!cache) {
-        flags = randomx_get_flags();
-        cache = randomx_alloc_cache(flags);
-       
-        randomx_init_cache(cache, randomx_seed2.GetHex().c_str(), randomx_seed2.GetHex().size());
+    explicit CRandomXDataset(randomx_dataset* datasetIn) : dataset(datasetIn) {}
+    ~CRandomXDataset()
+    {
+        randomx_release_dataset(dataset);
     }
- 
-    if (!rx_vm)
-        rx_vm = randomx_create_vm(flags, cache, nullptr);
+};
+
+typedef std::shared_ptr<CRandomXDataset> RandomXDatasetRef;
 
-    is_init = true;
+/**
+ * RandomX cache for one seed epoch. The cache is initialised lazily by the
+ * first thread that needs it; VMs keep a reference so an evicted epoch stays
+ * valid until the last thread using it moves on. In fast mode the epoch also
+ * gets a dataset once the background builder has finished it.
+ */
+class CRandomXSeedCache
+{
+public:
+    const uint256 seed;
+    CCriticalSection cs;
+    randomx_cache* cache;
+    RandomXDatasetRef dataset;
+    bool fDatasetQueued;
+    std::atomic<uint64_t> nLastUsed;
+
+    explicit CRandomXSeedCache(const uint256& seedIn) : seed(seedIn), cache(nullptr), fDatasetQueued(false), nLastUsed(0) {}
+    ~CRandomXSeedCache()
+    {
+        if (cache)
+            randomx_release_cache(cache);
     }
-    if (randomx_seed2!=seedhash) {
-        randomx_seed2 = seedhash;
-//        randomx_reinit();
-    randomx_destroy_vm(rx_vm);
-    randomx_release_cache(cache);
 
-    cache = randomx_alloc_cache(flags);
-    randomx_init_cache(cache, randomx_seed2.GetHex().c_str(), 64);
-    rx_vm = randomx_create_vm(flags, cache, nullptr);
+    void Init(randomx_flags flags)
+    {
+        LOCK(cs);
+        if (cache)
+            return;
+        cache = randomx_alloc_cache(flags | RANDOMX_FLAG_LARGE_PAGES);
+        if (!cache)
+            cache = randomx_alloc_cache(flags);
+        if (!cache)
+            throw std::runtime_error("RandomX: failed to allocate cache");
+        std::string key = seed.GetHex();
+        randomx_init_cache(cache, key.c_str(), key.size());
+    }
 
-    }   
+    RandomXDatasetRef GetDataset(bool& fQueued)
+    {
+        LOCK(cs);
+        fQueued = fDatasetQueued;
+        return dataset;
+    }
+};
 
-    randomx_calculate_hash(rx_vm, data, length, hash);
+typedef std::shared_ptr<CRandomXSeedCache> RandomXSeedCacheRef;
 
-        LEAVE_CRITICAL_SECTION(cs_randomx) 
+static void InitDatasetRange(randomx_dataset* dataset, randomx_cache* cache, unsigned long nStart, unsigned long nCount, const std::atomic<bool>* pfAbort)
+{
+    // Work in chunks so a shutdown does not wait for the whole range.
+    static const unsigned long nChunk = 1 << 16;
+    while (nCount > 0 && !*pfAbort) {
+        unsigned long n = std::min(nCount, nChunk);
+        randomx_init_dataset(dataset, cache, nStart, n);
+        nStart += n;
+        nCount -= n;
+    }
 }
 
+/**
+ * Pool of RandomX caches for the current and previous seed epochs.
+ * cs_randomx only guards the list of epochs and the dataset builder;
+ * cache initialisation and hashing happen outside of it.
+ */
+class CRandomXEngine
+{
+private:
+    randomx_flags flags;
+    std::vector<RandomXSeedCacheRef> vCaches;
+    std::atomic<uint64_t> nUseCounter;
+    std::atomic<bool> fFastMode;
+    std::atomic<bool> fShutdown;
+    int nDatasetThreads;
+    boost::thread threadBuilder;
+    bool fBuilding;
+
+    void BuildDataset(uint256 seed)
+    {
+        try {
+            RandomXSeedCacheRef entry = GetCache(seed);
+            bool fNeeded;
+            {
+                LOCK(entry->cs);
+                fNeeded = !entry->dataset && !entry->fDatasetQueued;
+                entry->fDatasetQueued = true;
+            }
+            if (fNeeded) {
+                int64_t nStart = GetTimeMillis();
+                randomx_dataset* dataset = randomx_alloc_dataset(flags | RANDOMX_FLAG_LARGE_PAGES);
+                if (!dataset)
+                    dataset = randomx_alloc_dataset(flags);
+                if (!dataset)
+                    throw std::runtime_error("failed to allocate dataset");
+
+                const unsigned long nItems = randomx_dataset_item_count();
+                boost::thread_group workers;
+                for (int i = 0; i < nDatasetThreads; i++) {
+                    unsigned long nBegin = nItems * i / nDatasetThreads;
+                    unsigned long nEnd = nItems * (i + 1) / nDatasetThreads;
+                    workers.create_thread(boost::bind(&InitDatasetRange, dataset, entry->cache, nBegin, nEnd - nBegin, &fShutdown));
+                }
+                workers.join_all();
+
+                if (fShutdown) {
+                    randomx_release_dataset(dataset);
+                } else {
+                    LOCK(entry->cs);
+                    entry->dataset = std::make_shared<CRandomXDataset>(dataset);
+                    LogPrintf("RandomX: dataset for seed %s built in %dms using %d threads\n", seed.GetHex(), GetTimeMillis() - nStart, nDatasetThreads);
+                }
+            }
+        } catch (const std::exception& e) {
+            LogPrintf("RandomX: %s, staying in light mode for seed %s\n", e.what(), seed.GetHex());
+        }
 
-void rx_slow_hash2(const char* data, char* hash, int length, uint256 seedhash)
+        LOCK(cs_randomx);
+        fBuilding = false;
+    }
+
+public:
+    CRandomXEngine() : flags(randomx_get_flags()), nUseCounter(0), fFastMode(false), fShutdown(false), nDatasetThreads(1), fBuilding(false) {}
+
+    randomx_flags GetFlags() const { return flags; }
+    bool IsFastMode() const { return fFastMode && !fShutdown; }
+
+    void SetFastMode(bool fEnable, int nThreads)
+    {
+        LOCK(cs_randomx);
+        nDatasetThreads = std::max(nThreads, 1);
+        fFastMode = fEnable;
+    }
+
+    RandomXSeedCacheRef GetCache(const uint256& seed)
+    {
+        RandomXSeedCacheRef entry;
+        {
+            LOCK(cs_randomx);
+            for (const RandomXSeedCacheRef& cache : vCaches) {
+                if (cache->seed == seed) {
+                    entry = cache;
+                    break;
+                }
+            }
+            if (!entry) {
+                // Evict the least recently hashed epoch to make room.
+                if (vCaches.size() >= RANDOMX_MAX_SEED_CACHES) {
+                    std::vector<RandomXSeedCacheRef>::iterator itOldest = vCaches.begin();
+                    for (std::vector<RandomXSeedCacheRef>::iterator it = vCaches.begin(); it != vCaches.end(); ++it) {
+                        if ((*it)->nLastUsed < (*itOldest)->nLastUsed)
+                            itOldest = it;
+                    }
+                    vCaches.erase(itOldest);
+                }
+                entry = std::make_shared<CRandomXSeedCache>(seed);
+                vCaches.push_back(entry);
+            }
+            Touch(*entry);
+        }
+        entry->Init(flags);
+        return entry;
+    }
+
+    void Touch(CRandomXSeedCache& entry)
+    {
+        entry.nLastUsed = ++nUseCounter;
+    }
+
+    /** Start building the dataset for seed in the background, unless the builder is busy. */
+    void RequestDataset(const uint256& seed)
+    {
+        if (!IsFastMode())
+            return;
+        LOCK(cs_randomx);
+        if (fBuilding || fShutdown)
+            return;
+        if (threadBuilder.joinable())
+            threadBuilder.join();
+        fBuilding = true;
+        threadBuilder = boost::thread(boost::bind(&CRandomXEngine::BuildDataset, this, seed));
+    }
+
+    void Shutdown()
+    {
+        boost::thread thread;
+        {
+            LOCK(cs_randomx);
+            fShutdown = true;
+            thread.swap(threadBuilder);
+        }
+        if (thread.joinable())
+            thread.join();
+    }
+};
+
+static CRandomXEngine& GetRandomXEngine()
 {
-        ENTER_CRITICAL_SECTION(cs_randomx) 
+    static CRandomXEngine engine;
+    return engine;
+}
 
-    static bool is_init; // = false;
-//    static char randomx_seed[64]; //={0}; // this should be 64 and not 32
-    static uint256 randomx_seed2;
-    static randomx_flags flags;
-    static randomx_vm *rx_vm; // = nullptr;
-    static randomx_cache *cache; // = nullptr;
+/** The VMs owned by one hashing thread, one per seed epoch. */
+class CRandomXThreadVMs
+{
+private:
+    struct Slot {
+        RandomXSeedCacheRef cache;
+        RandomXDatasetRef dataset;
+        randomx_vm* vm;
+        uint64_t nLastUsed;
+    };
+    Slot slots[RANDOMX_MAX_SEED_CACHES];
+    uint64_t nUseCounter;
+
+    static randomx_vm* CreateVM(randomx_flags flags, randomx_cache* cache, randomx_dataset* dataset)
+    {
+        randomx_vm* vm = randomx_create_vm(flags | RANDOMX_FLAG_LARGE_PAGES, cache, dataset);
+        if (!vm)
+            vm = randomx_create_vm(flags, cache, dataset);
+        if (!vm)
+            throw std::runtime_error("RandomX: failed to create VM");
+        return vm;
+    }
 
- 
-    if (!is_init) {
+public:
+    CRandomXThreadVMs() : nUseCounter(0)
+    {
+        for (Slot& slot : slots) {
+            slot.vm = nullptr;
+            slot.nLastUsed = 0;
+        }
+    }
 
-        randomx_seed2 = seedhash;
-    if (!cache) {
-        flags = randomx_get_flags();
-        cache = randomx_alloc_cache(flags);
-       
-        randomx_init_cache(cache, randomx_seed2.GetHex().c_str(), randomx_seed2.GetHex().size());
+    ~CRandomXThreadVMs()
+    {
+        for (Slot& slot : slots) {
+            if (slot.vm)
+                randomx_destroy_vm(slot.vm);
+        }
     }
- 
-    if (!rx_vm)
-        rx_vm = randomx_create_vm(flags, cache, nullptr);
 
-    is_init = true;
+    randomx_vm* GetVM(const uint256& seed)
+    {
+        CRandomXEngine& engine = GetRandomXEngine();
+
+        Slot* pslot = nullptr;
+        for (Slot& slot : slots) {
+            if (slot.cache && slot.cache->seed == seed) {
+                pslot = &slot;
+                break;
+            }
+            if (!pslot || slot.nLastUsed < pslot->nLastUsed)
+                pslot = &slot;
+        }
+
+        RandomXSeedCacheRef cache = pslot->cache;
+        if (cache && cache->seed == seed)
+            engine.Touch(*cache);
+        else
+            cache = engine.GetCache(seed);
+
+        RandomXDatasetRef dataset;
+        if (engine.IsFastMode()) {
+            bool fQueued;
+            dataset = cache->GetDataset(fQueued);
+            if (!dataset && !fQueued)
+                engine.RequestDataset(seed);
+        }
+
+        if (pslot->cache != cache || pslot->dataset != dataset) {
+            if (dataset) {
+                if (pslot->vm && pslot->dataset) {
+                    randomx_vm_set_dataset(pslot->vm, dataset->dataset);
+                } else {
+                    if (pslot->vm)
+                        randomx_destroy_vm(pslot->vm);
+                    pslot->vm = nullptr;
+                    pslot->vm = CreateVM(engine.GetFlags() | RANDOMX_FLAG_FULL_MEM, nullptr, dataset->dataset);
+                }
+            } else {
+                if (pslot->vm && !pslot->dataset) {
+                    randomx_vm_set_cache(pslot->vm, cache->cache);
+                } else {
+                    if (pslot->vm)
+                        randomx_destroy_vm(pslot->vm);
+                    pslot->vm = nullptr;
+                    pslot->vm = CreateVM(engine.GetFlags(), cache->cache, nullptr);
+                }
+            }
+            pslot->cache = cache;
+            pslot->dataset = dataset;
+        }
+
+        pslot->nLastUsed = ++nUseCounter;
+        return pslot->vm;
     }
-    if (randomx_seed2!=seedhash) {
+};
 
-        randomx_seed2 = seedhash;
-//        randomx_reinit();
-    randomx_destroy_vm(rx_vm);
-    randomx_release_cache(cache);
+static boost::thread_specific_ptr<CRandomXThreadVMs> rxThreadVMs;
 
-    cache = randomx_alloc_cache(flags);
-    randomx_init_cache(cache, randomx_seed2.GetHex().c_str(), 64);
-    rx_vm = randomx_create_vm(flags, cache, nullptr);
-    
+static void rx_hash(const char* data, char* hash, int length, const uint256& seedhash)
+{
+    if (!rxThreadVMs.get())
+        rxThreadVMs.reset(new CRandomXThreadVMs());
+    randomx_calculate_hash(rxThreadVMs->GetVM(seedhash), data, length, hash);
+}
 
-    }   
+void rx_slow_hash(const char* data, char* hash, int length, uint256 seedhash)
+{
+    rx_hash(data, hash, length, seedhash);
+}
 
-    randomx_calculate_hash(rx_vm, data, length, hash);
+void rx_slow_hash2(const char* data, char* hash, int length, uint256 seedhash)
+{
+    rx_hash(data, hash, length, seedhash);
+}
+
+void RandomXSetFastMode(bool fEnable, int nThreads)
+{
+    GetRandomXEngine().SetFastMode(fEnable, nThreads);
+}
 
-        LEAVE_CRITICAL_SECTION(cs_randomx) 
+void RandomXPrepareForHeight(int nTipHeight)
+{
+    CRandomXEngine& engine = GetRandomXEngine();
+    if (!engine.IsFastMode() || nTipHeight + RANDOMX_FASTMODE_PREPARE_BLOCKS < Params().SwitchRX2Block())
+        return;
+
+    // Build the dataset for the epoch the next block falls into, or the
+    // following one once it is close enough and its seed block is known.
+    int nSeedHeight = GetRandomXSeedHeight(nTipHeight + 1);
+    int nNextSeedHeight = GetRandomXSeedHeight(nTipHeight + 1 + RANDOMX_FASTMODE_PREPARE_BLOCKS);
+    if (nNextSeedHeight != nSeedHeight && nNextSeedHeight <= chainActive.Height())
+        engine.RequestDataset(nNextSeedHeight < 0 ? chainActive.Genesis()->GetBlockHash() : chainActive[nNextSeedHeight]->GetBlockHash());
+}
+
+void RandomXShutdown()
+{
+    GetRandomXEngine().Shutdown();
 }
 
 
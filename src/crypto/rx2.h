@@ -1,8 +1,17 @@
+#ifndef LUX_CRYPTO_RX2_H
+#define LUX_CRYPTO_RX2_H
 
 #include "chain.h"
 
 extern CChain chainActive;
 
+/** Number of seed epochs (current and previous) whose RandomX caches are kept alive at once */
+static const unsigned int RANDOMX_MAX_SEED_CACHES = 2;
+/** Default for -randomxfastmode */
+static const bool DEFAULT_RANDOMX_FASTMODE = false;
+/** How many blocks before a seed change the next epoch's dataset starts building in fast mode */
+static const int RANDOMX_FASTMODE_PREPARE_BLOCKS = 64;
+
 //bool seed_changed(uint256 newseed);
 //void seed_set(uint256 newseed);
 //void randomx_init();
@@ -10,3 +19,14 @@ extern CChain chainActive;
 void rx_slow_hash(const char* data, char* hash, int length, uint256 seedhash);
 void rx_slow_hash2(const char* data, char* hash, int length, uint256 seedhash);
 uint256 GetRandomXSeed(const uint32_t& nHeight);
+/** Like GetRandomXSeed, but returns false instead of crashing when the seed block is not in chainActive */
+bool GetRandomXSeed(const uint32_t& nHeight, uint256& seed);
+
+/** Use the full RandomX dataset (built with nThreads threads) instead of light mode */
+void RandomXSetFastMode(bool fEnable, int nThreads);
+/** In fast mode, start building the dataset for the upcoming seed epoch in the background */
+void RandomXPrepareForHeight(int nTipHeight);
+/** Stop the background dataset builder */
+void RandomXShutdown();
+
+#endif // LUX_CRYPTO_RX2_H
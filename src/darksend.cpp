@@ -130,21 +130,27 @@ void ProcessMessageDarksend(CNode* pfrom, const std::string& strCommand, CDataSt
         vRecv >> nDenom >> txCollateral;
 
         std::string error = "";
-        int mn = GetMasternodeByVin(activeMasternode.vin);
+        int mn;
+        bool fTooRecent = false;
+        {
+            // vecMasternodes is also updated by masternode messages on other handler threads
+            LOCK(cs_masternodes);
+            mn = GetMasternodeByVin(activeMasternode.vin);
+            if (mn != -1 && darkSendPool.sessionUsers == 0)
+                fTooRecent = vecMasternodes[mn].nLastDsq != 0 &&
+                             vecMasternodes[mn].nLastDsq + CountMasternodesAboveProtocol(darkSendPool.MIN_PEER_PROTO_VERSION) / 5 > darkSendPool.nDsqCount;
+        }
         if (mn == -1) {
             std::string strError = _("Not in the masternode list.");
             pfrom->PushMessage("dssu", darkSendPool.sessionID, darkSendPool.GetState(), darkSendPool.GetEntriesCount(), MASTERNODE_REJECTED, strError);
             return;
         }
 
-        if (darkSendPool.sessionUsers == 0) {
-            if (vecMasternodes[mn].nLastDsq != 0 &&
-                vecMasternodes[mn].nLastDsq + CountMasternodesAboveProtocol(darkSendPool.MIN_PEER_PROTO_VERSION) / 5 > darkSendPool.nDsqCount) {
-                //LogPrintf("dsa -- last dsq too recent, must wait. %s \n", vecMasternodes[mn].addr.ToString().c_str());
-                std::string strError = _("Last Darksend was too recent.");
-                pfrom->PushMessage("dssu", darkSendPool.sessionID, darkSendPool.GetState(), darkSendPool.GetEntriesCount(), MASTERNODE_REJECTED, strError);
-                return;
-            }
+        if (fTooRecent) {
+            //LogPrintf("dsa -- last dsq too recent, must wait. %s \n", vecMasternodes[mn].addr.ToString().c_str());
+            std::string strError = _("Last Darksend was too recent.");
+            pfrom->PushMessage("dssu", darkSendPool.sessionID, darkSendPool.GetState(), darkSendPool.GetEntriesCount(), MASTERNODE_REJECTED, strError);
+            return;
         }
 
         if (!darkSendPool.IsCompatibleWithSession(nDenom, txCollateral, error)) {
@@ -173,8 +179,7 @@ void ProcessMessageDarksend(CNode* pfrom, const std::string& strCommand, CDataSt
 
         if (dsq.IsExpired()) return;
 
-        int mn = GetMasternodeByVin(dsq.vin);
-        if (mn == -1) return;
+        if (GetMasternodeByVin(dsq.vin) == -1) return;
 
         // if the queue is ready, submit if we can
         if (dsq.ready) {
@@ -190,16 +195,23 @@ void ProcessMessageDarksend(CNode* pfrom, const std::string& strCommand, CDataSt
                 if (q.vin == dsq.vin) return;
             }
 
-            if (fDebug) LogPrintf("dsq last %d last2 %d count %d\n", vecMasternodes[mn].nLastDsq, vecMasternodes[mn].nLastDsq + (int) vecMasternodes.size() / 5, darkSendPool.nDsqCount);
-            //don't allow a few nodes to dominate the queuing process
-            if (vecMasternodes[mn].nLastDsq != 0 &&
-                vecMasternodes[mn].nLastDsq + CountMasternodesAboveProtocol(darkSendPool.MIN_PEER_PROTO_VERSION) / 5 > darkSendPool.nDsqCount) {
-                if (fDebug) LogPrintf("dsq -- masternode sending too many dsq messages. %s \n", vecMasternodes[mn].addr.ToString().c_str());
-                return;
+            {
+                // look the entry up again, another handler thread may have changed the list
+                LOCK(cs_masternodes);
+                int mn = GetMasternodeByVin(dsq.vin);
+                if (mn == -1) return;
+
+                if (fDebug) LogPrintf("dsq last %d last2 %d count %d\n", vecMasternodes[mn].nLastDsq, vecMasternodes[mn].nLastDsq + (int) vecMasternodes.size() / 5, darkSendPool.nDsqCount);
+                //don't allow a few nodes to dominate the queuing process
+                if (vecMasternodes[mn].nLastDsq != 0 &&
+                    vecMasternodes[mn].nLastDsq + CountMasternodesAboveProtocol(darkSendPool.MIN_PEER_PROTO_VERSION) / 5 > darkSendPool.nDsqCount) {
+                    if (fDebug) LogPrintf("dsq -- masternode sending too many dsq messages. %s \n", vecMasternodes[mn].addr.ToString().c_str());
+                    return;
+                }
+                darkSendPool.nDsqCount++;
+                vecMasternodes[mn].nLastDsq = darkSendPool.nDsqCount;
+                vecMasternodes[mn].allowFreeTx = true;
             }
-            darkSendPool.nDsqCount++;
-            vecMasternodes[mn].nLastDsq = darkSendPool.nDsqCount;
-            vecMasternodes[mn].allowFreeTx = true;
 
             if (fDebug) LogPrintf("dsq - new darksend queue object - %s\n", addr.ToString().c_str());
             vecDarksendQueue.push_back(dsq);
@@ -2116,7 +2128,8 @@ void ThreadCheckDarkSendPool() {
 
         if (c % 60 == 0) {
         {
-                LOCK(cs_masternodes);
+                // Check() takes cs_main, which goes before cs_masternodes
+                LOCK2(cs_main, cs_masternodes);
                 vector<CMasterNode>::iterator it = vecMasternodes.begin();
                 //check them separately
                 while (it != vecMasternodes.end()) {
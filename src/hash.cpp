@@ -254,4 +254,22 @@ uint64_t SipHashUint256Extra(uint64_t k0, uint64_t k1, const uint256& val, uint3
     SIPROUND;
     SIPROUND;
     return v0 ^ v1 ^ v2 ^ v3;
-}
\ No newline at end of file
+}
+namespace
+{
+/** Owns a thread's LYRA2 memory matrix and frees it when the thread exits */
+class CLyra2ThreadContext
+{
+public:
+    LYRA2_CTX ctx;
+
+    CLyra2ThreadContext() : ctx() {}
+    ~CLyra2ThreadContext() { LYRA2_ctx_free(&ctx); }
+};
+} // namespace
+
+int LYRA2ThreadLocal(void *K, int64_t kLen, const void *pwd, int32_t pwdlen, const void *salt, int32_t saltlen, int64_t timeCost, int16_t nRows, int16_t nCols)
+{
+    static thread_local CLyra2ThreadContext context;
+    return LYRA2_ctx(&context.ctx, K, kLen, pwd, pwdlen, salt, saltlen, timeCost, nRows, nCols);
+}
@@ -340,6 +340,9 @@ public:
 //int HMAC_SHA512_Update(HMAC_SHA512_CTX *pctx, const void *pdata, size_t len);
 //int HMAC_SHA512_Final(unsigned char *pmd, HMAC_SHA512_CTX *pctx);
 
+/** LYRA2 using a preallocated memory matrix owned by the calling thread */
+int LYRA2ThreadLocal(void *K, int64_t kLen, const void *pwd, int32_t pwdlen, const void *salt, int32_t saltlen, int64_t timeCost, int16_t nRows, int16_t nCols);
+
 /* ----------- Phi1612 Hash ------------------------------------------------ */
 
 template<typename T1>
@@ -362,8 +365,8 @@ inline uint256 phi2_hash(const T1 pbegin, const T1 pend)
     sph_cubehash512(&ctx_cubehash, (pbegin == pend ? pblank : static_cast<const void*>(&pbegin[0])), len);
     sph_cubehash512_close(&ctx_cubehash, (void*)hashB);
 
-    LYRA2(&hashA[ 0], 32, &hashB[ 0], 32, &hashB[ 0], 32, 1, 8, 8);
-    LYRA2(&hashA[32], 32, &hashB[32], 32, &hashB[32], 32, 1, 8, 8);
+    LYRA2ThreadLocal(&hashA[ 0], 32, &hashB[ 0], 32, &hashB[ 0], 32, 1, 8, 8);
+    LYRA2ThreadLocal(&hashA[32], 32, &hashB[32], 32, &hashB[32], 32, 1, 8, 8);
 
     sph_jh512_init(&ctx_jh);
     sph_jh512(&ctx_jh, (const void*)hashA, 64);
@@ -19,6 +19,8 @@
 #include "checkpoints.h"
 #include "compat/sanity.h"
 #include "consensus/validation.h"
+#include "crypto/lyra2/Lyra2.h"
+#include "crypto/rx2.h"
 #include "httpserver.h"
 #include "httprpc.h"
 #include "key.h"
@@ -223,6 +225,7 @@ void PrepareShutdown()
     // CScheduler/checkqueue threadGroup
     threadGroup.interrupt_all();
     threadGroup.join_all();
+    RandomXShutdown();
 
     if (fFeeEstimatesInitialized) {
         boost::filesystem::path est_path = GetDataDir() / FEE_ESTIMATES_FILENAME;
@@ -381,6 +384,7 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-?", _("This help message"));
     strUsage += HelpMessageOpt("-alertnotify=<cmd>", _("Execute command when a relevant alert is received or we see a really long fork (%s in cmd is replaced by message)"));
     strUsage += HelpMessageOpt("-alerts", strprintf(_("Receive and display P2P network alerts (default: %u)"), DEFAULT_ALERTS));
+    strUsage += HelpMessageOpt("-assumevalid=<hex>", _("If this block is in the chain assume that it and its ancestors are valid and potentially skip their script verification (0 to verify all, default: 0)"));
     strUsage += HelpMessageOpt("-blocknotify=<cmd>", _("Execute command when the best block changes (%s in cmd is replaced by block hash)"));
     strUsage += HelpMessageOpt("-checkblocks=<n>", strprintf(_("How many blocks to check at startup (default: %u, 0 = all)"), 500));
     strUsage += HelpMessageOpt("-checklevel=<n>", strprintf(_("How thorough the block verification of -checkblocks is (0-4, default: %u)"), 3));
@@ -392,14 +396,17 @@ std::string HelpMessage(HelpMessageMode mode)
     }
     strUsage += HelpMessageOpt("-datadir=<dir>", _("Specify data directory"));
     strUsage += HelpMessageOpt("-dbcache=<n>", strprintf(_("Set database cache size in megabytes (%d to %d, default: %d)"), nMinDbCache, nMaxDbCache, nDefaultDbCache));
+    strUsage += HelpMessageOpt("-evmcache=<n>", strprintf(_("Keep up to <n> megabytes of contract accounts and storage in memory across blocks (0 = disable, default: %d)"), DEFAULT_EVM_CACHE));
     strUsage += HelpMessageOpt("-nlogfile=<n>", _("Set number of debug log files"));
     strUsage += HelpMessageOpt("-loadblock=<file>", _("Imports blocks from external blk000??.dat file") + " " + _("on startup"));
     strUsage += HelpMessageOpt("-maxorphantx=<n>", strprintf(_("Keep at most <n> unconnectable transactions in memory (default: %u)"), DEFAULT_MAX_ORPHAN_TRANSACTIONS));
     strUsage += HelpMessageOpt("-maxmempool=<n>", strprintf(_("Keep the transaction memory pool below <n> megabytes (default: %u)"), DEFAULT_MAX_MEMPOOL_SIZE));
     strUsage += HelpMessageOpt("-par=<n>", strprintf(_("Set the number of script verification threads (1 to %d, 0 = auto, <0 = leave that many cores free, default: %d)"), (int)boost::thread::hardware_concurrency(), DEFAULT_SCRIPTCHECK_THREADS));
+    strUsage += HelpMessageOpt("-randomxfastmode", strprintf(_("Verify RandomX proof of work with the full dataset instead of light mode (needs about 2.5GB of extra memory, twice that around seed changes, default: %u)"), DEFAULT_RANDOMX_FASTMODE));
 #ifndef WIN32
     strUsage += HelpMessageOpt("-pid=<file>", strprintf(_("Specify pid file (default: %s)"), "luxd.pid"));
 #endif
+    strUsage += HelpMessageOpt("-prunestate=<n>", strprintf(_("Keep contract state history only for the last <n> blocks and delete older unreachable state (0 = disable, minimum %u when enabled). Changing this setting requires -reindex (default: %u)"), MIN_BLOCKS_TO_KEEP, 0));
     strUsage += HelpMessageOpt("-record-log-opcodes", _("Logs all EVM LOG opcode operations to the file vmExecLogs.json"));
     //Temporarily disabled until our chain doesn't grow in size
     //strUsage += HelpMessageOpt("-prune=<n>", _("Reduce storage requirements by pruning (deleting) old blocks. This mode disables wallet support and is incompatible with -txindex.") + " " + _("Warning: Reverting this setting requires re-downloading the entire blockchain.") + " " + _("(default: 0 = disable pruning blocks,") + " " + strprintf(_(">%u = target size in MiB to use for block files)"), MIN_DISK_SPACE_FOR_BLOCK_FILES / 1024 / 1024));
@@ -420,6 +427,8 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-bantime=<n>", strprintf(_("Number of seconds to keep misbehaving peers from reconnecting (default: %u)"), 86400));
     strUsage += HelpMessageOpt("-bind=<addr>", _("Bind to given address and always listen on it. Use [host]:port notation for IPv6"));
     strUsage += HelpMessageOpt("-connect=<ip>", _("Connect only to the specified node(s)"));
+    strUsage += HelpMessageOpt("-compactblocks", strprintf(_("Relay new blocks to and from peers as compact blocks of short transaction ids (default: %u)"), DEFAULT_COMPACTBLOCKS));
+    strUsage += HelpMessageOpt("-compacthbpeer=<netmask>", _("Ask peers from the given netmask or IP address to push new blocks to us as compact blocks without an inv round trip. Can be specified multiple times."));
     strUsage += HelpMessageOpt("-discover", _("Discover own IP address (default: 1 when listening and no -externalip)"));
     strUsage += HelpMessageOpt("-dns", _("Allow DNS lookups for -addnode, -seednode and -connect") + " " + _("(default: 1)"));
     strUsage += HelpMessageOpt("-dnsseed", _("Query for peer addresses via DNS lookup, if low on addresses (default: 1 unless -connect)"));
@@ -429,12 +438,14 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-maxconnections=<n>", strprintf(_("Maintain at most <n> connections to peers (default: %u)"), 125));
     strUsage += HelpMessageOpt("-maxreceivebuffer=<n>", strprintf(_("Maximum per-connection receive buffer, <n>*1000 bytes (default: %u)"), 5000));
     strUsage += HelpMessageOpt("-maxsendbuffer=<n>", strprintf(_("Maximum per-connection send buffer, <n>*1000 bytes (default: %u)"), 1000));
+    strUsage += HelpMessageOpt("-msghandthreads=<n>", strprintf(_("Number of threads processing peer messages (1 to %d, default: %d)"), MAX_MSGHANDLER_THREADS, DEFAULT_MSGHANDLER_THREADS));
     strUsage += HelpMessageOpt("-onion=<ip:port>", strprintf(_("Use separate SOCKS5 proxy to reach peers via Tor hidden services (default: %s)"), "-proxy"));
     strUsage += HelpMessageOpt("-onlynet=<net>", _("Only connect to nodes in network <net> (ipv4, ipv6 or onion)"));
     strUsage += HelpMessageOpt("-permitbaremultisig", strprintf(_("Relay non-P2SH multisig (default: %u)"), 1));
     strUsage += HelpMessageOpt("-port=<port>", strprintf(_("Listen for connections on <port> (default: %u or testnet: %u)"), 26969, 28333));
     strUsage += HelpMessageOpt("-proxy=<ip:port>", _("Connect through SOCKS5 proxy"));
     strUsage += HelpMessageOpt("-seednode=<ip>", _("Connect to a node to retrieve peer addresses, and disconnect"));
+    strUsage += HelpMessageOpt("-socketevents=<mode>", strprintf(_("Socket events mode, which must be one of: select, poll, epoll (default: %s)"), DEFAULT_SOCKETEVENTS));
     strUsage += HelpMessageOpt("-timeout=<n>", strprintf(_("Specify connection timeout in milliseconds (minimum: 1, default: %d)"), DEFAULT_CONNECT_TIMEOUT));
 #ifdef USE_UPNP
 #if USE_UPNP
@@ -497,7 +508,7 @@ std::string HelpMessage(HelpMessageMode mode)
         strUsage += HelpMessageOpt("-flushwallet", strprintf(_("Run a thread to flush wallet periodically (default: %u)"), 1));
         strUsage += HelpMessageOpt("-stopafterblockimport", strprintf(_("Stop running after importing blocks from disk (default: %u)"), 0));
     }
-    string debugCategories ="addrman, alert, bench, coindb, db, lock, rand, rpc, selectcoins, mempool, net"; // Don't translate these and qt below
+    string debugCategories ="addrman, alert, bench, cmpctblock, coindb, db, lock, rand, rpc, selectcoins, mempool, net, prefetch"; // Don't translate these and qt below
     if (mode == HMM_BITCOIN_QT)
         debugCategories +=", qt";
     strUsage += HelpMessageOpt("-debug=<category>", strprintf(_("Output debugging information (default: %u, supplying <category> is optional)"), 0) + ". " + _("If <category> is not supplied, output all debugging information.") + _("<category> can be:") + " " + debugCategories + ".");
@@ -642,6 +653,7 @@ void ThreadImport(std::vector<boost::filesystem::path> vImportFiles)
     // -reindex
     if (fReindex) {
         CImportingNow imp;
+        LoadAssumeValidChain(chainparams);
         int nFile = 0;
         while (true) {
             CDiskBlockPos pos(nFile, 0);
@@ -654,6 +666,7 @@ void ThreadImport(std::vector<boost::filesystem::path> vImportFiles)
             LoadExternalBlockFile(chainparams, file, &pos);
             nFile++;
         }
+        UnloadAssumeValidChain();
         pblocktree->WriteReindexing(false);
         fReindex = false;
         LogPrintf("Reindexing finished\n");
@@ -912,10 +925,17 @@ bool AppInit2()
         LogPrintf("%s: parameter interaction: additional indexes -> setting -checklevel=4\n", __func__);
     }
 
+    std::string strSocketEvents = GetArg("-socketevents", DEFAULT_SOCKETEVENTS);
+    if (!SetSocketEventsMode(strSocketEvents))
+        return InitError(strprintf(_("Invalid -socketevents ('%s') specified. Only these modes are supported: %s"), strSocketEvents, "select, poll, epoll"));
+
     // Make sure enough file descriptors are available
     int nBind = std::max((int)mapArgs.count("-bind") + (int)mapArgs.count("-whitebind"), 1);
     nMaxConnections = GetArg("-maxconnections", 125);
-    nMaxConnections = std::max(std::min(nMaxConnections, (int)(FD_SETSIZE - nBind - MIN_CORE_FILEDESCRIPTORS)), 0);
+    // select() can only watch descriptors below FD_SETSIZE
+    if (nSocketEventsMode == SOCKETEVENTS_SELECT)
+        nMaxConnections = std::min(nMaxConnections, (int)(FD_SETSIZE - nBind - MIN_CORE_FILEDESCRIPTORS));
+    nMaxConnections = std::max(nMaxConnections, 0);
     int nFD = RaiseFileDescriptorLimit(nMaxConnections + MIN_CORE_FILEDESCRIPTORS);
     if (nFD < MIN_CORE_FILEDESCRIPTORS)
         return InitError(_("Not enough file descriptors available."));
@@ -976,6 +996,10 @@ bool AppInit2()
     fCheckBlockIndex = GetBoolArg("-checkblockindex", chainparams.DefaultConsistencyChecks());
     Checkpoints::fEnabled = GetBoolArg("-checkpoints", true);
 
+    hashAssumeValid = uint256S(GetArg("-assumevalid", "0"));
+    if (hashAssumeValid != uint256(0))
+        LogPrintf("Assuming ancestors of block %s have valid signatures.\n", hashAssumeValid.GetHex());
+
     // Mempool size limit
     int64_t maxMempoolSize = GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000;
     if (maxMempoolSize < 0)
@@ -990,6 +1014,12 @@ bool AppInit2()
     else if (nScriptCheckThreads > MAX_SCRIPTCHECK_THREADS)
         nScriptCheckThreads = MAX_SCRIPTCHECK_THREADS;
 
+    if (GetBoolArg("-randomxfastmode", DEFAULT_RANDOMX_FASTMODE)) {
+        int nRandomXThreads = std::max((int)boost::thread::hardware_concurrency(), 1);
+        RandomXSetFastMode(true, nRandomXThreads);
+        LogPrintf("RandomX fast mode enabled, building datasets with %d threads\n", nRandomXThreads);
+    }
+
     fServer = GetBoolArg("-server", false);
     setvbuf(stdout, NULL, _IOLBF, 0); /// ***TODO*** do we still need this after -printtoconsole is gone?
 
@@ -1006,6 +1036,17 @@ bool AppInit2()
         fPruneMode = true;
     }
 
+    int64_t nSignedPruneStateDepth = GetArg("-prunestate", 0);
+    if (nSignedPruneStateDepth < 0) {
+        return InitError(_("Prune state cannot be configured with a negative value."));
+    }
+    if (nSignedPruneStateDepth > 0 && nSignedPruneStateDepth < MIN_BLOCKS_TO_KEEP) {
+        return InitError(strprintf(_("Prune state configured below the minimum of %d blocks.  Please use a higher number."), MIN_BLOCKS_TO_KEEP));
+    }
+    nPruneStateDepth = (unsigned int) nSignedPruneStateDepth;
+    if (nPruneStateDepth)
+        LogPrintf("Prune state configured to keep %u blocks of contract state history.\n", nPruneStateDepth);
+
 #ifdef ENABLE_WALLET
     bool fDisableWallet = GetBoolArg("-disablewallet", false);
 #endif
@@ -1096,6 +1137,8 @@ bool AppInit2()
     // ********************************************************* Step 4: application initialization: dir lock, daemonize, pidfile, debug log
     // Initialize elliptic curve code
     std::string sha256_algo = SHA256AutoDetect();
+    std::string lyra2_algo = LYRA2AutoDetect();
+    std::string keccak_algo = dev::sha3AutoDetect();
     ECC_Start();
     globalVerifyHandle.reset(new ECCVerifyHandle());
 
@@ -1128,6 +1171,8 @@ bool AppInit2()
     LogPrintf("LUX version %s (%s)\n", FormatFullVersion(), CLIENT_DATE);
     LogPrintf("Using OpenSSL version %s\n", SSLeay_version(SSLEAY_VERSION));
     LogPrintf("Using the %s SHA256 implementation\n", sha256_algo.c_str());
+    LogPrintf("Using the %s Lyra2 implementation\n", lyra2_algo.c_str());
+    LogPrintf("Using the %s Keccak implementation\n", keccak_algo.c_str());
 #ifdef ENABLE_WALLET
     LogPrintf("Using BerkeleyDB version %s\n", DbEnv::version(0, 0, 0));
 #endif
@@ -1151,6 +1196,13 @@ bool AppInit2()
     if (nScriptCheckThreads) {
         for (int i = 0; i < nScriptCheckThreads - 1; i++)
             threadGroup.create_thread(&ThreadScriptCheck);
+        // headers are only received with headers-first sync
+        if (chainparams.HeadersFirstSyncingActive()) {
+            for (int i = 0; i < nScriptCheckThreads - 1; i++)
+                threadGroup.create_thread(&ThreadHeaderCheck);
+        }
+        for (int i = 0; i < nScriptCheckThreads - 1; i++)
+            threadGroup.create_thread(&ThreadPrefetch);
     }
 
     if (mapArgs.count("-sporkkey")) // spork priv key
@@ -1350,6 +1402,16 @@ bool AppInit2()
         }
     }
 
+    fCompactBlocks = GetBoolArg("-compactblocks", DEFAULT_COMPACTBLOCKS);
+    if (mapArgs.count("-compacthbpeer")) {
+        for (const std::string& net : mapMultiArgs["-compacthbpeer"]) {
+            CSubNet subnet(net);
+            if (!subnet.IsValid())
+                return InitError(strprintf(_("Invalid netmask specified in -compacthbpeer: '%s'"), net));
+            vCompactHighBandwidthPeers.push_back(subnet);
+        }
+    }
+
     CService addrProxy;
     bool fProxy = false;
     if (mapArgs.count("-proxy")) {
@@ -1470,6 +1532,7 @@ bool AppInit2()
     nCoinDBCache = min(nCoinDBCache, nMaxCoinsDBCache << 20); // cap total coins db cache
     nTotalCache -= nCoinDBCache;
     nCoinCacheUsage = nTotalCache; // the rest goes to in-memory cache (300bytes)
+    int64_t nEVMCache = max(GetArg("-evmcache", DEFAULT_EVM_CACHE), (int64_t)0); // contract state cache, on top of -dbcache
 
     bool fLoaded = false;
     while (!fLoaded && !fRequestShutdown) {
@@ -1497,6 +1560,23 @@ bool AppInit2()
                 pcoinscatcher = new CCoinsViewErrorCatcher(pcoinsdbview);
                 pcoinsTip = new CCoinsViewCache(pcoinscatcher);
 
+                // Move a chainstate with per-transaction records to per-output entries
+                if (!pcoinsdbview->Upgrade()) {
+                    if (fRequestShutdown)
+                    {
+                        LogPrintf("Shutdown requested. Exiting.\n");
+                        return false;
+                    }
+                    strLoadError = _("Error upgrading chainstate database");
+                    break;
+                }
+
+                // UTXO set statistics for gettxoutsetinfo, maintained from here on by every flush
+                if (!pcoinsdbview->LoadStats()) {
+                    strLoadError = _("Error loading UTXO set statistics");
+                    break;
+                }
+
                 if (fReset) {
                     pblocktree->WriteReindexing(true);
                     if (fPruneMode)
@@ -1512,11 +1592,19 @@ bool AppInit2()
 
                 boost::filesystem::path luxStateDir = GetDataDir() / "stateLux";
 
+                // A pruned state database has to count every node reference from the start
+                if (fReset && nPruneStateDepth > 0) {
+                    LogPrintf("Wiping %s to rebuild it with -prunestate\n", luxStateDir.string());
+                    boost::filesystem::remove_all(luxStateDir);
+                }
+
                 bool fStatus = boost::filesystem::exists(luxStateDir);
                 const std::string dirLux(luxStateDir.string());
                 const dev::h256 hashDB(dev::sha3(dev::rlp("")));
                 dev::eth::BaseState existsLuxState = fStatus ? dev::eth::BaseState::PreExisting : dev::eth::BaseState::Empty;
                 globalState = std::unique_ptr<LuxState>(new LuxState(dev::u256(0), LuxState::openDB(dirLux, hashDB, dev::WithExisting::Trust), dirLux, existsLuxState));
+                if (nEVMCache > 0)
+                    globalState->setStateCache(std::make_shared<dev::eth::StateCache>((size_t)nEVMCache << 20));
                 dev::eth::ChainParams cp((dev::eth::genesisInfo(dev::eth::Network::luxMainNetwork)));
                 globalSealEngine = std::unique_ptr<dev::eth::SealEngineFace>(cp.createSealEngine());
 
@@ -1553,6 +1641,20 @@ bool AppInit2()
                     fGettingValuesDGP = false;
                 }
 
+                bool fPruneState = false;
+                pblocktree->ReadFlag("prunestate", fPruneState);
+                if (fReset || !fStatus) {
+                    fPruneState = nPruneStateDepth > 0;
+                    pblocktree->WriteFlag("prunestate", fPruneState);
+                } else if (fPruneState != (nPruneStateDepth > 0)) {
+                    strLoadError = _("You need to rebuild the database using -reindex to change -prunestate");
+                    break;
+                }
+                if (fPruneState) {
+                    globalState->db().enablePruning();
+                    globalState->dbUtxo().enablePruning();
+                }
+
                 if(chainActive.Tip() != nullptr && chainActive.Tip()->nHeight > Params().FirstSCBlock()){
                     globalState->setRoot(uintToh256(chainActive.Tip()->hashStateRoot));
                     globalState->setRootUTXO(uintToh256(chainActive.Tip()->hashUTXORoot));
@@ -1591,8 +1693,13 @@ bool AppInit2()
                 {
                     pstorageresult->wipeResults();
                     pblocktree->WipeHeightIndex();
+                    pblocktree->WipeLogTopicIndex();
                     fLogEvents = false;
                     pblocktree->WriteFlag("logevents", fLogEvents);
+                    fLogTopicIndex = false;
+                    pblocktree->WriteFlag("logtopicindex", fLogTopicIndex);
+                } else if (!fLogTopicIndex) {
+                    LogPrintf("Log topic index not built, searchlogs with topics falls back to scanning; use -reindex to build it\n");
                 }
 
                 nLogFile = GetArg("-nlogfile", 1);
@@ -311,9 +311,11 @@ void DoConsensusVote(CTransaction& tx, int64_t nBlockHeight) {
 bool ProcessConsensusVote(CConsensusVote& ctx) {
     int n = GetMasternodeRank(ctx.vinMasternode, ctx.nBlockHeight, MIN_PROTO_VERSION);
 
-    int x = GetMasternodeByVin(ctx.vinMasternode);
-    if (x != -1) {
-        if (fDebug) LogPrintf("InstantX::ProcessConsensusVote - Masternode ADDR %s %d\n", vecMasternodes[x].addr.ToString().c_str(), n);
+    if (fDebug) {
+        LOCK(cs_masternodes);
+        int x = GetMasternodeByVin(ctx.vinMasternode);
+        if (x != -1)
+            LogPrintf("InstantX::ProcessConsensusVote - Masternode ADDR %s %d\n", vecMasternodes[x].addr.ToString().c_str(), n);
     }
 
     if (n == -1) {
@@ -467,14 +469,19 @@ bool CConsensusVote::SignatureValid() {
     std::string errorMessage;
     std::string strMessage = txHash.ToString().c_str() + boost::lexical_cast<std::string>(nBlockHeight);
 
-    int n = GetMasternodeByVin(vinMasternode);
+    CPubKey pubkey2;
+    {
+        LOCK(cs_masternodes);
+        int n = GetMasternodeByVin(vinMasternode);
 
-    if (n == -1) {
-        LogPrintf("InstantX::CConsensusVote::SignatureValid() - Unknown Masternode\n");
-        return false;
+        if (n == -1) {
+            LogPrintf("InstantX::CConsensusVote::SignatureValid() - Unknown Masternode\n");
+            return false;
+        }
+        pubkey2 = vecMasternodes[n].pubkey2;
     }
 
-    if (!darkSendSigner.VerifyMessage(vecMasternodes[n].pubkey2, vchMasterNodeSignature, strMessage, errorMessage)) {
+    if (!darkSendSigner.VerifyMessage(pubkey2, vchMasterNodeSignature, strMessage, errorMessage)) {
         LogPrintf("InstantX::CConsensusVote::SignatureValid() - Verify message failed\n");
         return false;
     }
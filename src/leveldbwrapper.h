@@ -170,6 +170,12 @@ public:
     {
         return pdb->NewIterator(iteroptions);
     }
+
+    // for short prefix scans on lookup paths, which should fill the block cache like Read does
+    leveldb::Iterator* NewLookupIterator()
+    {
+        return pdb->NewIterator(readoptions);
+    }
 };
 
 #endif // BITCOIN_LEVELDBWRAPPER_H